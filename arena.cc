@@ -0,0 +1,89 @@
+/* arena.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "arena.hh"
+
+using namespace socc;
+
+Arena::Arena (Arena &&other) :
+  chunks (std::move (other.chunks)), ptr (other.ptr), left (other.left),
+  next_chunk_size (other.next_chunk_size), chunk_bytes (other.chunk_bytes),
+  destructors (other.destructors)
+{
+  other.ptr = nullptr;
+  other.left = 0;
+  other.next_chunk_size = MIN_CHUNK_SIZE;
+  other.chunk_bytes = 0;
+  other.destructors = nullptr;
+}
+
+Arena &
+Arena::operator= (Arena &&other)
+{
+  if (this != &other)
+    {
+      run_destructors ();
+      chunks = std::move (other.chunks);
+      ptr = other.ptr;
+      left = other.left;
+      next_chunk_size = other.next_chunk_size;
+      chunk_bytes = other.chunk_bytes;
+      destructors = other.destructors;
+      other.ptr = nullptr;
+      other.left = 0;
+      other.next_chunk_size = MIN_CHUNK_SIZE;
+      other.chunk_bytes = 0;
+      other.destructors = nullptr;
+    }
+  return *this;
+}
+
+void
+Arena::run_destructors (void)
+{
+  while (destructors != nullptr)
+    {
+      Destructor *entry = destructors;
+      destructors = entry->next;
+      entry->destroy (entry->obj);
+    }
+}
+
+/* Starts a new chunk. Requests too large to share a chunk get one of
+   their own, and the current chunk stays open for later small ones. */
+
+void *
+Arena::allocate_slow (size_t size, size_t align)
+{
+  size_t need = size + align - 1;
+  if (need > MAX_CHUNK_SIZE / 4)
+    {
+      chunks.emplace_back (new char[need]);
+      chunk_bytes += need;
+      char *base = chunks.back ().get ();
+      return base + (-(uintptr_t) base & (align - 1));
+    }
+  size_t chunk_size = next_chunk_size;
+  while (chunk_size < need)
+    chunk_size *= 2;
+  if (next_chunk_size < MAX_CHUNK_SIZE)
+    next_chunk_size *= 2;
+  chunks.emplace_back (new char[chunk_size]);
+  chunk_bytes += chunk_size;
+  ptr = chunks.back ().get ();
+  left = chunk_size;
+  return allocate (size, align);
+}
@@ -0,0 +1,139 @@
+/* arena.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _ARENA_HH
+#define _ARENA_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace socc
+{
+  /* Fixed-length array living in an arena. Nodes use it for child lists,
+     which are collected elsewhere and copied in once their length is
+     known, so a list takes no heap block of its own and never grows. */
+  template <typename T>
+  class ArenaArray
+  {
+    T *ptr;
+    uint32_t len;
+
+  public:
+    ArenaArray (void) : ptr (nullptr), len (0) {}
+    ArenaArray (T *ptr, size_t len) : ptr (ptr), len (len) {}
+
+    T *begin (void) const { return ptr; }
+    T *end (void) const { return ptr + len; }
+    size_t size (void) const { return len; }
+    bool empty (void) const { return len == 0; }
+    T &operator[] (size_t i) const { return ptr[i]; }
+  };
+
+  /* Bump-pointer allocator. Memory is carved out of chunks that grow from
+     MIN_CHUNK_SIZE to MAX_CHUNK_SIZE bytes, and is only released, all at
+     once, when the arena is destroyed. Objects made with create whose
+     types have non-trivial destructors are destroyed then too, in the
+     reverse order of their creation. */
+  class Arena
+  {
+    static constexpr size_t MIN_CHUNK_SIZE = 4096;
+    static constexpr size_t MAX_CHUNK_SIZE = 65536;
+
+    struct Destructor
+    {
+      void (*destroy) (void *obj);
+      void *obj;
+      Destructor *next;
+    };
+
+    std::vector <std::unique_ptr <char[]>> chunks;
+    char *ptr;
+    size_t left;
+    size_t next_chunk_size;
+    size_t chunk_bytes;
+    Destructor *destructors;
+
+    void *allocate_slow (size_t size, size_t align);
+    void run_destructors (void);
+
+    template <typename T>
+    static void
+    destroy (void *obj)
+    {
+      static_cast <T *> (obj)->~T ();
+    }
+
+  public:
+    Arena (void) :
+      ptr (nullptr), left (0), next_chunk_size (MIN_CHUNK_SIZE),
+      chunk_bytes (0), destructors (nullptr) {}
+    Arena (const Arena &) = delete;
+    Arena (Arena &&other);
+    ~Arena (void) { run_destructors (); }
+    Arena &operator= (const Arena &) = delete;
+    Arena &operator= (Arena &&other);
+
+    /* Bytes in the chunks allocated so far, used or not */
+    size_t memory_usage (void) const { return chunk_bytes; }
+
+    void *
+    allocate (size_t size, size_t align = alignof (std::max_align_t))
+    {
+      size_t pad = -(uintptr_t) ptr & (align - 1);
+      if (pad + size > left)
+	return allocate_slow (size, align);
+      char *result = ptr + pad;
+      ptr += pad + size;
+      left -= pad + size;
+      return result;
+    }
+
+    template <typename T, typename... Args>
+    T *
+    create (Args &&...args)
+    {
+      void *mem = allocate (sizeof (T), alignof (T));
+      T *obj = new (mem) T (std::forward <Args> (args)...);
+      if (!std::is_trivially_destructible <T>::value)
+	{
+	  void *entry = allocate (sizeof (Destructor), alignof (Destructor));
+	  destructors = new (entry) Destructor {destroy <T>, obj, destructors};
+	}
+      return obj;
+    }
+
+    /* Copies COUNT elements starting at DATA into the arena */
+    template <typename T>
+    ArenaArray <T>
+    copy_array (const T *data, size_t count)
+    {
+      static_assert (std::is_trivially_destructible <T>::value,
+		     "arena arrays are never destroyed");
+      if (count == 0)
+	return ArenaArray <T> ();
+      T *mem = static_cast <T *> (allocate (sizeof (T) * count, alignof (T)));
+      std::uninitialized_copy (data, data + count, mem);
+      return ArenaArray <T> (mem, count);
+    }
+  };
+}
+
+#endif
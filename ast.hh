@@ -17,10 +17,16 @@
 #ifndef _AST_HH
 #define _AST_HH
 
+#include <cassert>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
+#include "arena.hh"
 #include "token.hh"
 #include "type.hh"
+#include "writer.hh"
 
 namespace socc
 {
@@ -71,236 +77,515 @@ namespace socc
     AssignOr
   };
 
+  const char *unary_operator_spelling (UnaryOperator op);
+  const char *binary_operator_spelling (BinaryOperator op);
+
+  /* Concrete node classes. Expressions come first and file-scope
+     declarations last, so the abstract classes can test for a range. */
+  enum class NodeKind : unsigned char
+  {
+    String,
+    Integer,
+    Call,
+    ArrayIndex,
+    MemberAccess,
+    Variable,
+    Unary,
+    Binary,
+    ExprStmt,
+    Return,
+    Block,
+    VariableDeclaration,
+    FuncDeclaration,
+    FuncDefinition
+  };
+
+  /* AST nodes are allocated in an arena and refer to each other with
+     plain pointers. They are never deleted one at a time: the arena runs
+     the destructors of the nodes that need it when it is freed. Nodes have
+     no virtual functions; code that needs the concrete class switches on
+     KIND, directly or through Visitor, and converts with cast or
+     dyn_cast. */
   class AST
   {
+  protected:
+    AST (NodeKind kind, Location loc) : kind (kind), loc (loc) {}
+    ~AST (void) = default;
+
   public:
-    virtual ~AST (void) = default;
-    virtual Location &location (void) = 0;
-    virtual void print (std::ostream &os) const = 0;
+    const NodeKind kind;
+    Location loc;
+
+    static bool classof (const AST *) { return true; }
+    Location location (void) const { return loc; }
+    void print (Writer &os) const;
   };
 
   class ExprAST : public AST
   {
+  protected:
+    ExprAST (NodeKind kind, Location loc) : AST (kind, loc) {}
+
   public:
-    virtual bool is_lvalue (void) = 0;
+    static bool classof (const AST *node)
+    {
+      return node->kind <= NodeKind::Binary;
+    }
+    bool is_lvalue (void) const;
+    ExprAST *child (size_t i) const;
   };
 
-  typedef std::unique_ptr <ExprAST> ExprPtr;
+  typedef ExprAST *ExprPtr;
 
   class StatementAST : public AST
   {
+  protected:
+    StatementAST (NodeKind kind, Location loc) : AST (kind, loc) {}
+
+  public:
+    static bool classof (const AST *node)
+    {
+      return node->kind >= NodeKind::ExprStmt;
+    }
   };
 
-  typedef std::unique_ptr <StatementAST> StatementPtr;
+  typedef StatementAST *StatementPtr;
 
-  class FileScopeDeclAST : public AST
+  /* Declarations are statements too, so every node has a single AST base
+     and a pointer to any of its classes can be cast to any other */
+  class FileScopeDeclAST : public StatementAST
   {
+  protected:
+    FileScopeDeclAST (NodeKind kind, Location loc) :
+      StatementAST (kind, loc) {}
+
+  public:
+    static bool classof (const AST *node)
+    {
+      return node->kind >= NodeKind::VariableDeclaration;
+    }
   };
 
-  typedef std::unique_ptr <FileScopeDeclAST> FileScopeDeclPtr;
+  typedef FileScopeDeclAST *FileScopeDeclPtr;
 
-  class StringAST : public ExprAST
+  template <typename T, typename From>
+  inline bool
+  isa (const From *node)
+  {
+    return T::classof (node);
+  }
+
+  /* Converts NODE to class T, which it must be an instance of. The result
+     is const if NODE is. */
+  template <typename T, typename From>
+  inline auto
+  cast (From *node)
+  {
+    assert (isa <T> (node));
+    return static_cast <std::conditional_t <std::is_const_v <From>,
+					    const T, T> *> (node);
+  }
+
+  /* Like cast, but returns null if NODE is not an instance of T */
+  template <typename T, typename From>
+  inline auto
+  dyn_cast (From *node)
   {
+    return isa <T> (node) ? cast <T> (node) : nullptr;
+  }
+
+  /* A top-level declaration returned by Context::next_decl, together with
+     the arena holding its tree. Dropping the handle frees the whole tree
+     at once. */
+  class DeclHandle
+  {
+    std::unique_ptr <Arena> arena;
+    FileScopeDeclAST *decl;
+
   public:
-    Location loc;
-    std::string str;
+    DeclHandle (void) : decl (nullptr) {}
+    DeclHandle (FileScopeDeclAST *decl, std::unique_ptr <Arena> arena) :
+      arena (std::move (arena)), decl (decl) {}
+
+    FileScopeDeclAST *get (void) const { return decl; }
+    FileScopeDeclAST &operator* (void) const { return *decl; }
+    FileScopeDeclAST *operator-> (void) const { return decl; }
+    explicit operator bool (void) const { return decl != nullptr; }
+
+    /* Bytes held by the arena of the declaration */
+    size_t
+    memory_usage (void) const
+    {
+      return arena ? arena->memory_usage () : 0;
+    }
+  };
 
-    StringAST (Location loc, std::string str) : loc (loc), str (str) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return false; }
+  /* Adjacent string literals are kept as separate decoded pieces, which
+     point into the source buffer or the token stream of the context that
+     parsed them, and are only joined when value is called */
+  class StringAST : public ExprAST
+  {
+  public:
+    ArenaArray <std::string_view> pieces;
+
+    StringAST (Location loc, ArenaArray <std::string_view> pieces) :
+      ExprAST (NodeKind::String, loc), pieces (pieces) {}
+    std::string value (void) const;
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::String;
+    }
+    void print (Writer &os) const;
   };
 
   class IntegerAST : public ExprAST
   {
   public:
-    Location loc;
     unsigned long long value;
     IntLiteralWidth width;
-
-    IntegerAST (Location loc, unsigned long long value, IntLiteralWidth width) :
-      loc (loc), value (value), width (width) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return false; }
+    bool is_unsigned;
+
+    IntegerAST (Location loc, unsigned long long value, IntLiteralWidth width,
+		bool is_unsigned) :
+      ExprAST (NodeKind::Integer, loc), value (value), width (width),
+      is_unsigned (is_unsigned) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Integer;
+    }
+    void print (Writer &os) const;
   };
 
   class CallAST : public ExprAST
   {
   public:
-    Location loc;
     ExprPtr func;
-    std::vector <ExprPtr> params;
-
-    CallAST (Location loc, ExprPtr func, std::vector <ExprPtr> params) :
-      loc (loc), func (std::move (func)), params (std::move (params)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return false; }
+    ArenaArray <ExprPtr> params;
+
+    CallAST (Location loc, ExprPtr func, ArenaArray <ExprPtr> params) :
+      ExprAST (NodeKind::Call, loc), func (func), params (params) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Call;
+    }
   };
 
   class ArrayIndexAST : public ExprAST
   {
   public:
-    Location loc;
     ExprPtr array;
     ExprPtr index;
 
     ArrayIndexAST (Location loc, ExprPtr array, ExprPtr index) :
-      loc (loc), array (std::move (array)), index (std::move (index)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return true; }
+      ExprAST (NodeKind::ArrayIndex, loc), array (array), index (index) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::ArrayIndex;
+    }
   };
 
   class MemberAccessAST : public ExprAST
   {
   public:
-    Location loc;
     ExprPtr operand;
-    std::string member;
+    Symbol member;
     bool deref;
 
-    MemberAccessAST (Location loc, ExprPtr operand, std::string member,
+    MemberAccessAST (Location loc, ExprPtr operand, Symbol member,
 		     bool deref) :
-      loc (loc), operand (std::move (operand)), member (member),
-      deref (deref) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return true; }
+      ExprAST (NodeKind::MemberAccess, loc), operand (operand),
+      member (member), deref (deref) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::MemberAccess;
+    }
   };
 
   class VariableAST : public ExprAST
   {
   public:
-    Location loc;
-    std::string name;
-
-    VariableAST (Location loc, std::string name) : loc (loc), name (name) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return true; }
+    Symbol name;
+
+    VariableAST (Location loc, Symbol name) :
+      ExprAST (NodeKind::Variable, loc), name (name) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Variable;
+    }
+    void print (Writer &os) const;
   };
 
   class UnaryAST : public ExprAST
   {
   public:
-    Location loc;
     UnaryOperator op;
     ExprPtr operand;
 
     UnaryAST (Location loc, UnaryOperator op, ExprPtr operand) :
-      loc (loc), op (op), operand (std::move (operand)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return op == UnaryOperator::Dereference; }
+      ExprAST (NodeKind::Unary, loc), op (op), operand (operand) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Unary;
+    }
   };
 
   class BinaryAST : public ExprAST
   {
   public:
-    Location loc;
     BinaryOperator op;
     ExprPtr lhs;
     ExprPtr rhs;
 
     BinaryAST (Location loc, BinaryOperator op, ExprPtr lhs, ExprPtr rhs) :
-      loc (loc), op (op), lhs (std::move (lhs)), rhs (std::move (rhs)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
-    bool is_lvalue (void) { return false; }
+      ExprAST (NodeKind::Binary, loc), op (op), lhs (lhs), rhs (rhs) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Binary;
+    }
   };
 
   class ExprStmtAST : public StatementAST
   {
   public:
-    Location loc;
     ExprPtr expr;
 
     ExprStmtAST (Location loc, ExprPtr expr) :
-      loc (loc), expr (std::move (expr)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
+      StatementAST (NodeKind::ExprStmt, loc), expr (expr) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::ExprStmt;
+    }
+    void print (Writer &os) const;
   };
 
   class ReturnAST : public StatementAST
   {
   public:
-    Location loc;
     ExprPtr value;
 
     ReturnAST (Location loc, ExprPtr value) :
-      loc (loc), value (std::move (value)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
+      StatementAST (NodeKind::Return, loc), value (value) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Return;
+    }
+    void print (Writer &os) const;
   };
 
   class BlockAST : public StatementAST
   {
   public:
-    Location loc;
-    std::vector <StatementPtr> body;
+    ArenaArray <StatementPtr> body;
     unsigned int indent;
 
-    BlockAST (Location loc, std::vector <StatementPtr> body,
+    BlockAST (Location loc, ArenaArray <StatementPtr> body,
 	      unsigned int indent) :
-      loc (loc), body (std::move (body)), indent (indent) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
+      StatementAST (NodeKind::Block, loc), body (body), indent (indent) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::Block;
+    }
+    void print (Writer &os) const;
   };
 
-  class VariableDeclarationAST : public StatementAST, public FileScopeDeclAST
+  class VariableDeclarationAST : public FileScopeDeclAST
   {
   public:
-    Location loc;
     TypePtr type;
-    std::string name;
+    Symbol name;
     ExprPtr initval;
 
-    VariableDeclarationAST (Location loc, TypePtr type, std::string name) :
-      loc (loc), type (std::move (type)), name (name) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
+    VariableDeclarationAST (Location loc, TypePtr type, Symbol name) :
+      FileScopeDeclAST (NodeKind::VariableDeclaration, loc),
+      type (std::move (type)), name (name), initval (nullptr) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::VariableDeclaration;
+    }
+    void print (Writer &os) const;
   };
 
   class FuncDeclarationAST : public FileScopeDeclAST
   {
   public:
-    Location loc;
     TypePtr rettype;
-    std::string name;
-    std::vector <TypePtr> params;
+    Symbol name;
+    ArenaArray <TypePtr> params;
     bool empty_params;
 
-    FuncDeclarationAST (Location loc, TypePtr rettype, std::string name,
-			std::vector <TypePtr> params, bool empty_params) :
-      loc (loc), rettype (std::move (rettype)), name (name),
-      params (std::move (params)), empty_params (empty_params) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
+    FuncDeclarationAST (Location loc, TypePtr rettype, Symbol name,
+			ArenaArray <TypePtr> params, bool empty_params) :
+      FileScopeDeclAST (NodeKind::FuncDeclaration, loc), rettype (rettype),
+      name (name), params (params), empty_params (empty_params) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::FuncDeclaration;
+    }
+    void print (Writer &os) const;
   };
 
   class FuncDefinitionAST : public FileScopeDeclAST
   {
   public:
-    Location loc;
     TypePtr rettype;
-    std::string name;
-    std::vector <std::pair <TypePtr, std::string>> params;
+    Symbol name;
+    ArenaArray <std::pair <TypePtr, Symbol>> params;
     bool empty_params;
-    std::unique_ptr <BlockAST> body;
-
-    FuncDefinitionAST (Location loc, TypePtr rettype, std::string name,
-		       std::vector <std::pair <TypePtr, std::string>> params,
-		       bool empty_params, std::unique_ptr <BlockAST> body) :
-      loc (loc), rettype (std::move (rettype)), name (name),
-      params (std::move (params)), empty_params (empty_params),
-      body (std::move (body)) {}
-    Location &location (void) { return loc; }
-    void print (std::ostream &os) const;
+    BlockAST *body;
+
+    FuncDefinitionAST (Location loc, TypePtr rettype, Symbol name,
+		       ArenaArray <std::pair <TypePtr, Symbol>> params,
+		       bool empty_params, BlockAST *body) :
+      FileScopeDeclAST (NodeKind::FuncDefinition, loc), rettype (rettype),
+      name (name), params (params), empty_params (empty_params),
+      body (body) {}
+    static bool classof (const AST *node)
+    {
+      return node->kind == NodeKind::FuncDefinition;
+    }
+    void print (Writer &os) const;
+  };
+
+  inline bool
+  ExprAST::is_lvalue (void) const
+  {
+    switch (kind)
+      {
+      case NodeKind::ArrayIndex:
+      case NodeKind::MemberAccess:
+      case NodeKind::Variable:
+	return true;
+      case NodeKind::Unary:
+	return cast <UnaryAST> (this)->op == UnaryOperator::Dereference;
+      default:
+	return false;
+      }
+  }
+
+  /* Static visitor over AST nodes. DERIVED defines visit_* handlers for
+     the classes it cares about and hides the defaults below, which fall
+     back to visit_expr, visit_decl or visit_statement and finally to
+     visit_node. Calls are resolved at compile time and dispatch is a
+     single switch on the node kind, so handlers can be inlined. */
+  template <typename Derived, typename Ret = void>
+  class Visitor
+  {
+    Derived &derived (void) { return static_cast <Derived &> (*this); }
+
+  public:
+    Ret
+    visit (const AST *node)
+    {
+      switch (node->kind)
+	{
+	case NodeKind::String:
+	  return derived ().visit_string (cast <StringAST> (node));
+	case NodeKind::Integer:
+	  return derived ().visit_integer (cast <IntegerAST> (node));
+	case NodeKind::Call:
+	  return derived ().visit_call (cast <CallAST> (node));
+	case NodeKind::ArrayIndex:
+	  return derived ().visit_array_index (cast <ArrayIndexAST> (node));
+	case NodeKind::MemberAccess:
+	  return derived ().visit_member_access (cast <MemberAccessAST> (node));
+	case NodeKind::Variable:
+	  return derived ().visit_variable (cast <VariableAST> (node));
+	case NodeKind::Unary:
+	  return derived ().visit_unary (cast <UnaryAST> (node));
+	case NodeKind::Binary:
+	  return derived ().visit_binary (cast <BinaryAST> (node));
+	case NodeKind::ExprStmt:
+	  return derived ().visit_expr_stmt (cast <ExprStmtAST> (node));
+	case NodeKind::Return:
+	  return derived ().visit_return (cast <ReturnAST> (node));
+	case NodeKind::Block:
+	  return derived ().visit_block (cast <BlockAST> (node));
+	case NodeKind::VariableDeclaration:
+	  return derived ().visit_variable_declaration
+	    (cast <VariableDeclarationAST> (node));
+	case NodeKind::FuncDeclaration:
+	  return derived ().visit_func_declaration
+	    (cast <FuncDeclarationAST> (node));
+	case NodeKind::FuncDefinition:
+	  return derived ().visit_func_definition
+	    (cast <FuncDefinitionAST> (node));
+	}
+      return derived ().visit_node (node);
+    }
+
+    Ret visit_string (const StringAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_integer (const IntegerAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_call (const CallAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_array_index (const ArrayIndexAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_member_access (const MemberAccessAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_variable (const VariableAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_unary (const UnaryAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_binary (const BinaryAST *node)
+    {
+      return derived ().visit_expr (node);
+    }
+    Ret visit_expr_stmt (const ExprStmtAST *node)
+    {
+      return derived ().visit_statement (node);
+    }
+    Ret visit_return (const ReturnAST *node)
+    {
+      return derived ().visit_statement (node);
+    }
+    Ret visit_block (const BlockAST *node)
+    {
+      return derived ().visit_statement (node);
+    }
+    Ret visit_variable_declaration (const VariableDeclarationAST *node)
+    {
+      return derived ().visit_decl (node);
+    }
+    Ret visit_func_declaration (const FuncDeclarationAST *node)
+    {
+      return derived ().visit_decl (node);
+    }
+    Ret visit_func_definition (const FuncDefinitionAST *node)
+    {
+      return derived ().visit_decl (node);
+    }
+
+    Ret visit_expr (const ExprAST *node)
+    {
+      return derived ().visit_node (node);
+    }
+    Ret visit_decl (const FileScopeDeclAST *node)
+    {
+      return derived ().visit_statement (node);
+    }
+    Ret visit_statement (const StatementAST *node)
+    {
+      return derived ().visit_node (node);
+    }
+    Ret visit_node (const AST *) { return Ret (); }
   };
 }
 
-std::ostream &operator<< (std::ostream &os, const socc::AST &ast);
+socc::Writer &operator<< (socc::Writer &os, const socc::AST &ast);
 
 #endif
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# Usage: chains.py SOCC N [OPTION...]
+# Times socc with the given options on the sources of tests/stress.py,
+# which chain or nest expressions and statements N deep, and prints the
+# best of three runs for each. Fails if socc crashes on any of them.
+
+import os
+import subprocess
+import sys
+import time
+
+sys.path.insert (0, os.path.join (os.path.dirname (os.path.abspath
+                                                   (__file__)),
+                                  '..', 'tests'))
+from stress import SHAPES
+
+def main ():
+    socc = sys.argv[1]
+    n = int (sys.argv[2])
+    options = sys.argv[3:]
+    failed = False
+    for name, shape in SHAPES.items ():
+        source = shape (n).encode ()
+        best = None
+        for _ in range (3):
+            start = time.perf_counter ()
+            proc = subprocess.run ([socc] + options, input=source,
+                                   stdout=subprocess.DEVNULL,
+                                   stderr=subprocess.DEVNULL)
+            elapsed = time.perf_counter () - start
+            if proc.returncode not in (0, 1):
+                print ('%s-%d: socc exited with status %d'
+                       % (name, n, proc.returncode))
+                failed = True
+                break
+            if best is None or elapsed < best:
+                best = elapsed
+        if best is not None:
+            print ('%s-%d: %.1f ms' % (name, n, best * 1000))
+    return 1 if failed else 0
+
+if __name__ == '__main__':
+    sys.exit (main ())
@@ -0,0 +1,156 @@
+/* integers.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Compares converting the digits of integer literals with the
+   multiply-by-10 loop the lexer used to have against scan_integer, and
+   hexadecimal digits with a plain per-digit loop.
+   Usage: integers [LITERALS] */
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "scan.hh"
+#include "source.hh"
+
+using namespace socc;
+
+/* Makes a buffer of LITERALS literals of 1 to 19 digits in BASE (10 or
+   16) separated by spaces, and returns the offset of each. The buffer
+   ends in zero padding, as a SourceBuffer does. */
+static std::vector <size_t>
+generate (std::string &text, unsigned long literals, unsigned int base)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::vector <size_t> offsets;
+  unsigned long seed = base;
+  for (unsigned long i = 0; i < literals; i++)
+    {
+      seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+      unsigned int len = (seed >> 33) % (base == 10 ? 19 : 16) + 1;
+      offsets.push_back (text.size ());
+      for (unsigned int j = 0; j < len; j++)
+	{
+	  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	  text += digits[(seed >> 33) % base];
+	}
+      text += ' ';
+    }
+  text.append (SourceBuffer::PADDING, '\0');
+  return offsets;
+}
+
+static inline unsigned int
+hex_value (char c)
+{
+  return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+/* Runs FN several times and returns the fastest run in milliseconds */
+static double
+best_of (const std::function <void (void)> &fn)
+{
+  double best = 0;
+  for (int i = 0; i < 7; i++)
+    {
+      auto start = std::chrono::steady_clock::now ();
+      fn ();
+      std::chrono::duration <double, std::milli> elapsed =
+	std::chrono::steady_clock::now () - start;
+      if (i == 0 || elapsed.count () < best)
+	best = elapsed.count ();
+    }
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long literals = argc > 1 ? strtoul (argv[1], nullptr, 10)
+    : 3200000;
+  std::string dec_text;
+  std::string hex_text;
+  std::vector <size_t> dec = generate (dec_text, literals, 10);
+  std::vector <size_t> hex = generate (hex_text, literals, 16);
+
+  /* The old lexer read a digit at a time and never checked for
+     overflow */
+  unsigned long long loop_sum = 0;
+  double loop_ms = best_of ([&] {
+    loop_sum = 0;
+    for (size_t offset : dec)
+      {
+	const char *p = dec_text.data () + offset;
+	unsigned long long value = 0;
+	while (isdigit ((unsigned char) *p))
+	  value = value * 10 + (*p++ - '0');
+	loop_sum += value;
+      }
+  });
+
+  unsigned long long dec_sum = 0;
+  double dec_ms = best_of ([&] {
+    dec_sum = 0;
+    for (size_t offset : dec)
+      {
+	unsigned long long value;
+	bool overflow;
+	scan_integer (dec_text.data () + offset, 10, value, overflow);
+	dec_sum += value;
+      }
+  });
+
+  unsigned long long hex_loop_sum = 0;
+  double hex_loop_ms = best_of ([&] {
+    hex_loop_sum = 0;
+    for (size_t offset : hex)
+      {
+	const char *p = hex_text.data () + offset;
+	unsigned long long value = 0;
+	while (isxdigit ((unsigned char) *p))
+	  value = value << 4 | hex_value (*p++);
+	hex_loop_sum += value;
+      }
+  });
+
+  unsigned long long hex_sum = 0;
+  double hex_ms = best_of ([&] {
+    hex_sum = 0;
+    for (size_t offset : hex)
+      {
+	unsigned long long value;
+	bool overflow;
+	scan_integer (hex_text.data () + offset, 16, value, overflow);
+	hex_sum += value;
+      }
+  });
+
+  std::cout << literals << " literals of each base\n"
+	    << "decimal, multiply loop:      " << loop_ms << " ms\n"
+	    << "decimal, scan_integer:       " << dec_ms << " ms\n"
+	    << "hexadecimal, per-digit loop: " << hex_loop_ms << " ms\n"
+	    << "hexadecimal, scan_integer:   " << hex_ms << " ms"
+	    << std::endl;
+  if (loop_sum != dec_sum || hex_loop_sum != hex_sum)
+    {
+      std::cerr << "integers: the conversions disagree" << std::endl;
+      return 1;
+    }
+  return 0;
+}
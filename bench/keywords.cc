@@ -0,0 +1,150 @@
+/* keywords.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Compares classifying words with the unordered_map the lexer used to
+   keep keywords in against the perfect hash of lookup_keyword.
+   Usage: keywords [WORDS] */
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "token.hh"
+
+using namespace socc;
+
+static const char *const keyword_names[] = {
+  "auto", "break", "case", "char", "const", "continue", "default", "do",
+  "double", "else", "enum", "extern", "float", "for", "goto", "if",
+  "inline", "int", "long", "register", "restrict", "return", "short",
+  "signed", "sizeof", "static", "switch", "typedef", "union", "unsigned",
+  "void", "volatile", "while"
+};
+
+static const char *const identifier_names[] = {
+  "a", "b", "i", "n", "p", "x", "len", "buf", "count", "value", "result",
+  "index", "node", "next", "size_t", "printf", "memcpy", "structure",
+  "interrupt", "do_work", "whilst", "integer", "voidp", "charset"
+};
+
+/* Makes a buffer of words separated by spaces, about one in three of
+   them a keyword, and returns the spans of the words */
+static std::vector <std::string_view>
+generate (std::string &text, unsigned long words)
+{
+  size_t nkeywords = sizeof (keyword_names) / sizeof (*keyword_names);
+  size_t nidents = sizeof (identifier_names) / sizeof (*identifier_names);
+  std::vector <size_t> offsets;
+  unsigned long seed = 1;
+  for (unsigned long i = 0; i < words; i++)
+    {
+      seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+      size_t r = seed >> 33;
+      const char *word = r % 3 == 0 ? keyword_names[r / 3 % nkeywords]
+	: identifier_names[r / 3 % nidents];
+      offsets.push_back (text.size ());
+      text += word;
+      text += ' ';
+    }
+
+  std::vector <std::string_view> spans;
+  for (size_t i = 0; i < offsets.size (); i++)
+    {
+      size_t end = i + 1 < offsets.size () ? offsets[i + 1] : text.size ();
+      spans.emplace_back (text.data () + offsets[i], end - offsets[i] - 1);
+    }
+  return spans;
+}
+
+/* Runs FN several times and returns the fastest run in milliseconds */
+static double
+best_of (const std::function <void (void)> &fn)
+{
+  double best = 0;
+  for (int i = 0; i < 7; i++)
+    {
+      auto start = std::chrono::steady_clock::now ();
+      fn ();
+      std::chrono::duration <double, std::milli> elapsed =
+	std::chrono::steady_clock::now () - start;
+      if (i == 0 || elapsed.count () < best)
+	best = elapsed.count ();
+    }
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long words = argc > 1 ? strtoul (argv[1], nullptr, 10) : 2500000;
+  std::string text;
+  std::vector <std::string_view> spans = generate (text, words);
+
+  std::unordered_map <std::string, TokenType> keyword_map;
+  for (const char *name : keyword_names)
+    {
+      TokenType type;
+      if (!lookup_keyword (name, std::char_traits <char>::length (name),
+			   type))
+	{
+	  std::cerr << "keywords: " << name << " is not a keyword"
+		    << std::endl;
+	  return 1;
+	}
+      keyword_map[name] = type;
+    }
+
+  /* The old lexer made a string of every word, then asked the map for it
+     twice */
+  size_t map_sum = 0;
+  double map_ms = best_of ([&] {
+    map_sum = 0;
+    for (std::string_view span : spans)
+      {
+	std::string word (span);
+	if (keyword_map.count (word))
+	  map_sum += (size_t) keyword_map[word];
+	else
+	  map_sum += (size_t) TokenType::Identifier;
+      }
+  });
+
+  size_t hash_sum = 0;
+  double hash_ms = best_of ([&] {
+    hash_sum = 0;
+    for (std::string_view span : spans)
+      {
+	TokenType type = TokenType::Identifier;
+	lookup_keyword (span.data (), span.size (), type);
+	hash_sum += (size_t) type;
+      }
+  });
+
+  std::cout << spans.size () << " words, " << text.size () << " bytes\n"
+	    << "unordered_map count+operator[]: " << map_ms << " ms\n"
+	    << "perfect hash:                   " << hash_ms << " ms"
+	    << std::endl;
+  if (map_sum != hash_sum)
+    {
+      std::cerr << "keywords: the classifiers disagree" << std::endl;
+      return 1;
+    }
+  return 0;
+}
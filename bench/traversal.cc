@@ -0,0 +1,171 @@
+/* traversal.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Compares a recursive walk over the pointer-based AST with a linear
+   pass over the nodes of the equivalent FlatAST, and the memory each
+   form holds.
+   Usage: traversal [FUNCTIONS] */
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include "compilation.hh"
+#include "flat-ast.hh"
+
+using namespace socc;
+
+/* Each pass sums this over the nodes it visits, so that it has to look
+   at every node and the two passes can be checked against each other */
+static inline size_t
+weight (NodeKind kind)
+{
+  return (size_t) kind + 1;
+}
+
+/* Sums the weights of a tree, recursing into every child */
+class TreeWalk : public Visitor <TreeWalk, size_t>
+{
+public:
+  size_t
+  visit_expr (const ExprAST *node)
+  {
+    size_t sum = weight (node->kind);
+    for (size_t i = 0; ExprAST *child = node->child (i); i++)
+      sum += visit (child);
+    return sum;
+  }
+  size_t
+  visit_expr_stmt (const ExprStmtAST *node)
+  {
+    return weight (node->kind) + visit (node->expr);
+  }
+  size_t
+  visit_return (const ReturnAST *node)
+  {
+    return weight (node->kind) + (node->value ? visit (node->value) : 0);
+  }
+  size_t
+  visit_block (const BlockAST *node)
+  {
+    size_t sum = weight (node->kind);
+    for (StatementPtr stmt : node->body)
+      sum += visit (stmt);
+    return sum;
+  }
+  size_t
+  visit_variable_declaration (const VariableDeclarationAST *node)
+  {
+    return weight (node->kind)
+      + (node->initval ? visit (node->initval) : 0);
+  }
+  size_t
+  visit_func_definition (const FuncDefinitionAST *node)
+  {
+    return weight (node->kind) + visit (node->body);
+  }
+  size_t visit_node (const AST *node) { return weight (node->kind); }
+};
+
+static std::string
+generate (unsigned long functions)
+{
+  std::string text;
+  for (unsigned long i = 0; i < functions; i++)
+    {
+      std::string name = "f" + std::to_string (i);
+      text += "int\n" + name + " (int a, int b)\n{\n"
+	"  int c = a * 3 + b;\n"
+	"  c = c - (a << 2) / (b + 1);\n"
+	"  {\n"
+	"    int d = -c;\n"
+	"    c += " + name + " (a, d) + p->x[c] + q.y;\n"
+	"  }\n"
+	"  return c == 0 || !a;\n"
+	"}\n";
+    }
+  return text;
+}
+
+/* Runs FN several times and returns the fastest run in milliseconds */
+static double
+best_of (const std::function <void (void)> &fn)
+{
+  double best = 0;
+  for (int i = 0; i < 7; i++)
+    {
+      auto start = std::chrono::steady_clock::now ();
+      fn ();
+      std::chrono::duration <double, std::milli> elapsed =
+	std::chrono::steady_clock::now () - start;
+      if (i == 0 || elapsed.count () < best)
+	best = elapsed.count ();
+    }
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long functions = argc > 1 ? strtoul (argv[1], nullptr, 10) : 100000;
+  std::string text = generate (functions);
+  Compilation comp ("traversal.c", text);
+  if (!comp.ok ())
+    {
+      std::cerr << "traversal: generated source failed to compile"
+		<< std::endl;
+      return 1;
+    }
+
+  SessionGuard use_session (comp.session ());
+  FlatAST flat;
+  size_t tree_bytes = 0;
+  for (const DeclHandle &decl : comp.declarations ())
+    {
+      flat.add (*decl);
+      tree_bytes += decl.memory_usage ();
+    }
+
+  size_t tree_sum = 0;
+  double tree_ms = best_of ([&] {
+    TreeWalk walk;
+    tree_sum = 0;
+    for (const DeclHandle &decl : comp.declarations ())
+      tree_sum += walk.visit (decl.get ());
+  });
+
+  size_t flat_sum = 0;
+  double flat_ms = best_of ([&] {
+    flat_sum = 0;
+    for (const FlatNode &node : flat.nodes)
+      flat_sum += weight (node.kind);
+  });
+
+  std::cout << text.size () << " bytes, " << flat.nodes.size ()
+	    << " nodes\n"
+	    << "recursive walk of the pointer tree: " << tree_ms << " ms\n"
+	    << "linear pass over FlatAST::nodes:    " << flat_ms << " ms\n"
+	    << "arenas of the pointer trees: " << tree_bytes << " bytes\n"
+	    << "FlatAST:                     " << flat.memory_usage ()
+	    << " bytes" << std::endl;
+  if (tree_sum != flat_sum)
+    {
+      std::cerr << "traversal: the passes disagree" << std::endl;
+      return 1;
+    }
+  return 0;
+}
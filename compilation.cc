@@ -0,0 +1,95 @@
+/* compilation.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include <sstream>
+#include "compilation.hh"
+#include "flat-ast.hh"
+
+using namespace socc;
+
+Compilation::Compilation (std::string name, std::string_view text,
+			  const CompileOptions &opts) : color (opts.color)
+{
+  SessionGuard use_session (compile_session);
+  SourceBuffer buffer;
+  buffer.copy (text);
+  context = std::make_unique <Context> (std::move (name), std::move (buffer));
+  context->set_max_nesting (opts.max_nesting);
+  context->set_color (opts.color);
+  context->set_diagnostic_handler ([this] (const Diagnostic &diag)
+				   {
+				     diags.push_back (diag);
+				   });
+  auto keep = [this] (DeclHandle &decl)
+    {
+      decls.push_back (std::move (decl));
+    };
+  if (opts.jobs > 1)
+    context->parse_all (opts.jobs, keep);
+  else
+    {
+      while (DeclHandle decl = context->next_decl ())
+	keep (decl);
+    }
+}
+
+PresumedLocation
+Compilation::presumed (Location loc)
+{
+  return compile_session.sources.presumed (loc);
+}
+
+/* Formats a diagnostic as the compiler prints it */
+
+std::string
+Compilation::format (const Diagnostic &diag)
+{
+  SessionGuard use_session (compile_session);
+  std::ostringstream os;
+  print_diagnostic (os, diag, color);
+  return os.str ();
+}
+
+/* Writes each declaration after its location, as a tree or, if FLAT is
+   set, in the flat form */
+
+void
+Compilation::print (Writer &out, bool flat)
+{
+  SessionGuard use_session (compile_session);
+  FlatAST flat_ast;
+  for (const DeclHandle &decl : decls)
+    {
+      out << decl->location () << ": ";
+      if (flat)
+	flat_ast.print (out, flat_ast.add (*decl));
+      else
+	out << *decl;
+      out << '\n';
+    }
+}
+
+std::string
+Compilation::output (bool flat)
+{
+  std::string str;
+  {
+    Writer out (str);
+    print (out, flat);
+  }
+  return str;
+}
@@ -0,0 +1,78 @@
+/* compilation.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#ifndef _COMPILATION_HH
+#define _COMPILATION_HH
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "context.hh"
+#include "session.hh"
+
+namespace socc
+{
+  struct CompileOptions
+  {
+    unsigned int max_nesting = Context::DEFAULT_MAX_NESTING;
+    unsigned int jobs = 1;
+    bool color = false;
+  };
+
+  /* Entry point for programs that embed the compiler. Compiles a buffer
+     in a session of its own, so any number of compilations may run at
+     once on different threads. The declarations and diagnostics stay
+     valid as long as the compilation; code that walks the declarations
+     itself must make its session current with a SessionGuard before
+     looking at symbols, types or locations. */
+  class Compilation
+  {
+    /* Everything below refers to the session, so it is destroyed last */
+    Session compile_session;
+    std::unique_ptr <Context> context;
+    std::vector <DeclHandle> decls;
+    std::vector <Diagnostic> diags;
+    bool color;
+
+  public:
+    Compilation (std::string name, std::string_view text,
+		 const CompileOptions &opts = CompileOptions ());
+    Compilation (const Compilation &) = delete;
+    Compilation &operator= (const Compilation &) = delete;
+
+    Session &session (void) { return compile_session; }
+    bool ok (void) const { return context->error_count () == 0; }
+    const std::vector <DeclHandle> &
+    declarations (void) const
+    {
+      return decls;
+    }
+    const std::vector <Diagnostic> &
+    diagnostics (void) const
+    {
+      return diags;
+    }
+
+    PresumedLocation presumed (Location loc);
+    std::string format (const Diagnostic &diag);
+    void print (Writer &out, bool flat = false);
+    std::string output (bool flat = false);
+  };
+}
+
+#endif
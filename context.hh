@@ -17,61 +17,193 @@
 #ifndef _CONTEXT_HH
 #define _CONTEXT_HH
 
+#include <functional>
 #include <istream>
-#include <stack>
+#include <memory>
+#include <string>
+#include <vector>
 #include "ast.hh"
+#include "diagnostics.hh"
+#include "scope.hh"
+#include "source.hh"
 
 namespace socc
 {
   class Context
   {
-    std::stack <char> char_stack;
-    std::stack <TokenPtr> token_stack;
+    uint32_t file;
+    const char *start;
+    const char *cursor;
+    const char *limit;
+
+    /* Tokens are lexed into the stream as the parser first looks at them,
+       or all at once by tokenize. When parse_all lexes the whole stream
+       ahead of the parser, it keeps the diagnostics of the lexer in
+       lex_diagnostics, and each is reported once the parser first looks
+       at its token, where it would have come out otherwise. A slice
+       parses the tokens before token_end of a stream lexed by another
+       context, and sets overrun if it looks beyond them. */
+    struct LexDiagnostic
+    {
+      size_t token;
+      Diagnostic diag;
+    };
+    std::shared_ptr <TokenStream> tokens;
+    std::shared_ptr <const std::vector <LexDiagnostic>> lex_diagnostics;
+    size_t token_pos;
+    size_t token_end;
+    size_t peek_end;
+    bool overrun;
+
+    /* Arena for the nodes of the declaration being parsed */
+    std::unique_ptr <Arena> arena;
+
+    /* Child lists being collected. Nested constructs push their children
+       above those of the enclosing one, and each moves its own into the
+       arena with take_list when it is done. */
+    std::vector <ExprPtr> expr_stack;
+    std::vector <StatementPtr> stmt_stack;
+    std::vector <std::string_view> string_pieces;
+
+    /* Operators waiting for their operands, so that long chains of them
+       are parsed in a loop instead of by recursion */
+    struct PendingUnary
+    {
+      Location loc;
+      UnaryOperator op;
+    };
+    struct PendingBinary
+    {
+      ExprPtr lhs;
+      BinaryOperator op;
+      unsigned int prec;
+    };
+    std::vector <PendingUnary> unary_stack;
+    std::vector <PendingBinary> binary_stack;
+
+    DiagnosticHandler diagnostic_handler;
+    bool color;
     unsigned int errors;
     unsigned int indent;
 
+    /* Parentheses, brackets, argument lists and blocks still need the C
+       stack, so their nesting is limited */
+    unsigned int depth;
+    unsigned int max_depth;
+
+    /* Names declared at the current point of the parse, kept apart as C
+       keeps ordinary identifiers, struct tags and typedef names. There is
+       no grammar for struct tags or typedef declarations yet, so only
+       ORDINARY is ever filled in. */
+    ScopedTable ordinary;
+    ScopedTable tags;
+    ScopedTable typedef_names;
+
+    template <typename T, typename... Args>
+    T *
+    create (Args &&...args)
+    {
+      return arena->create <T> (std::forward <Args> (args)...);
+    }
+
+    template <typename T>
+    ArenaArray <T>
+    take_list (std::vector <T> &stack, size_t base)
+    {
+      ArenaArray <T> list =
+	arena->copy_array (stack.data () + base, stack.size () - base);
+      stack.resize (base);
+      return list;
+    }
+
+    void
+    push_scope (void)
+    {
+      ordinary.push_scope ();
+      tags.push_scope ();
+      typedef_names.push_scope ();
+    }
+    void
+    pop_scope (void)
+    {
+      ordinary.pop_scope ();
+      tags.pop_scope ();
+      typedef_names.pop_scope ();
+    }
     char next_char (void);
+    char peek_char (void);
+    void unget_char (char c);
     bool next_char_escaped (char &c);
-    TokenPtr scan_word (char c);
-    TokenPtr scan_number (char c);
-    TokenPtr scan_char (void);
-    TokenPtr scan_string (void);
-    bool expr_get_unary_op (TokenType type, UnaryOperator &op);
-    bool expr_get_binary_op (TokenType type, BinaryOperator &op);
-    unsigned int expr_get_binary_prec (BinaryOperator op);
-    void expr_call_build_params (std::vector <ExprPtr> &params);
-    StatementPtr stmt_handle_parse_error (void);
+    Token scan_word (void);
+    Token scan_number (char c);
+    Token scan_char (void);
+    Token scan_string (void);
+    Token scan_punctuator (char c);
+    Token lex_token (void);
+    void append_token (void);
+    void report_lex_diagnostics (size_t end);
+    bool enter_nested (void);
+    void skip_nested (void);
+    ArenaArray <ExprPtr> expr_call_build_params (bool &valid);
+    bool stmt_handle_parse_error (void);
     ExprPtr parse_expr_atomic (void);
     ExprPtr parse_expr_basic (void);
     ExprPtr parse_expr_suffix (ExprPtr expr);
     ExprPtr parse_expr_member_access (ExprPtr expr, bool deref);
     ExprPtr parse_expr_array_index (ExprPtr expr);
-    ExprPtr parse_expr_binary (ExprPtr lhs, unsigned int minprec);
+    ExprPtr parse_expr_binary (ExprPtr lhs);
+    ExprPtr fold_unary (Location loc, UnaryOperator op, ExprPtr operand);
+    ExprPtr simplify_binary (Location loc, BinaryOperator op, ExprPtr lhs,
+			     ExprPtr rhs);
+    ExprPtr fold_binary (Location loc, BinaryOperator op, ExprPtr lhs,
+			 ExprPtr rhs);
     StatementPtr parse_stmt_return_expr (Location loc, bool ret);
-    std::unique_ptr <BlockAST> parse_stmt_block (Location loc);
-    StatementPtr parse_stmt_variable_declaration (Location loc, TypePtr type);
+    BlockAST *parse_stmt_block (Location loc);
+    StatementPtr parse_stmt_variable_declaration (Location loc, TypePtr type,
+						  Symbol name);
     FileScopeDeclPtr parse_decl_func (Location loc, TypePtr type,
-				      std::string name);
+				      Symbol name);
+    FileScopeDeclPtr parse_decl (void);
+    std::vector <std::pair <size_t, size_t>> split_decls (void);
+
+    Context (const Context &parent, size_t begin, size_t end,
+	     DiagnosticHandler handler);
 
   public:
-    Location currloc;
-    std::istream &stream;
+    static constexpr unsigned int DEFAULT_MAX_NESTING = 256;
 
-    Context (std::string name, std::istream &stream) :
-      indent (0), currloc (name), stream (stream) {}
+    Context (std::string name, SourceBuffer buffer);
+    Context (std::string name, std::istream &stream);
+    Location currloc (void) const;
+    void set_max_nesting (unsigned int n) { max_depth = n; }
+    void set_color (bool enable) { color = enable; }
+    void
+    set_diagnostic_handler (DiagnosticHandler handler)
+    {
+      diagnostic_handler = std::move (handler);
+    }
+    unsigned int error_count (void) const { return errors; }
     std::string bold (std::string str);
     void warning (Location loc, std::string msg, std::string option = "");
     void error (Location loc, std::string msg);
-    TokenPtr next_token (void);
+    Token peek_token (unsigned int n = 0);
+    void consume_token (void);
+    Token next_token (void);
+    const TokenStream &tokenize (void);
+    std::string_view string_literal (const Token &token) const
+    {
+      return tokens->string (token.str);
+    }
     ExprPtr next_expr (void);
     StatementPtr next_statement (void);
-    FileScopeDeclPtr next_decl (void);
+    DeclHandle next_decl (void);
+    void parse_all (unsigned int jobs,
+		    const std::function <void (DeclHandle &)> &handle);
     TypePtr parse_type (Location loc, TypeContext tctx);
   };
 
-  void init_console (void);
-  void fatal_error (std::string msg, std::string option = "");
-  void print_escaped_string (std::ostream &os, std::string str);
+  void print_escaped_chars (Writer &os, std::string_view str);
+  void print_escaped_string (Writer &os, std::string_view str);
 }
 
 #endif
@@ -17,78 +17,78 @@
 #include <iostream>
 #include <unistd.h>
 #include "context.hh"
-
-static bool use_color;
+#include "session.hh"
 
 std::string
 socc::Context::bold (std::string str)
 {
-  return use_color ? "\033[1m" + str + "\033[0m" : "\"" + str + "\"";
+  return color ? "\033[1m" + str + "\033[0m" : "\"" + str + "\"";
 }
 
 void
 socc::Context::warning (socc::Location loc, std::string msg, std::string option)
 {
-  if (use_color)
-    std::cerr << "\033[35;1mwarning: \033[39m";
-  else
-    std::cerr << "warning: ";
-  std::cerr << loc;
-  if (use_color)
-    std::cerr << ":\033[0m ";
-  else
-    std::cerr << ": ";
-  std::cerr << msg;
-  if (option.empty ())
-    std::cerr << std::endl;
-  else if (use_color)
-    std::cerr << " [\033[35;1m" << option << "\033[0m]" << std::endl;
-  else
-    std::cerr << " [" << option << ']' << std::endl;
+  diagnostic_handler ({DiagnosticKind::Warning, loc, std::move (msg),
+		       std::move (option)});
 }
 
 void
 socc::Context::error (socc::Location loc, std::string msg)
 {
-  if (use_color)
-    std::cerr << "\033[31;1merror: \033[39m";
-  else
-    std::cerr << "error: ";
-  std::cerr << loc;
-  if (use_color)
-    std::cerr << ":\033[0m ";
-  else
-    std::cerr << ": ";
-  std::cerr << msg << std::endl;
+  diagnostic_handler ({DiagnosticKind::Error, loc, std::move (msg), ""});
   errors++;
 }
 
 void
-socc::init_console (void)
+socc::print_diagnostic (std::ostream &os, const Diagnostic &diag, bool color)
 {
-  if (isatty (STDERR_FILENO))
-    use_color = true;
+  bool is_error = diag.kind == DiagnosticKind::Error;
+  if (color)
+    os << (is_error ? "\033[31;1merror: \033[39m"
+	   : "\033[35;1mwarning: \033[39m");
+  else
+    os << (is_error ? "error: " : "warning: ");
+  os << diag.loc;
+  if (color)
+    os << ":\033[0m ";
+  else
+    os << ": ";
+  os << diag.message;
+  if (diag.option.empty ())
+    os << std::endl;
+  else if (color)
+    os << " [\033[35;1m" << diag.option << "\033[0m]" << std::endl;
+  else
+    os << " [" << diag.option << ']' << std::endl;
 }
 
 void
-socc::fatal_error (std::string msg, std::string option)
+socc::print_fatal_error (std::ostream &os, bool color, std::string msg,
+			 std::string option)
 {
-  if (use_color)
-    std::cerr << "\033[31;1mfatal error: \033[0m";
+  if (color)
+    os << "\033[31;1mfatal error: \033[0m";
   else
-    std::cerr << "fatal error: ";
-  std::cerr << msg;
+    os << "fatal error: ";
+  os << msg;
   if (option.empty ())
-    std::cerr << std::endl;
-  else if (use_color)
-    std::cerr << " [\033[31;1m" << option << "\033[0m]" << std::endl;
+    os << std::endl;
+  else if (color)
+    os << " [\033[31;1m" << option << "\033[0m]" << std::endl;
   else
-    std::cerr << " [" << option << ']' << std::endl;
+    os << " [" << option << ']' << std::endl;
+}
+
+void
+socc::fatal_error (std::string msg, std::string option)
+{
+  print_fatal_error (std::cerr, isatty (STDERR_FILENO), msg, option);
   exit (1);
 }
 
 std::ostream &
 operator<< (std::ostream &os, const socc::Location &loc)
 {
-  return os << loc.name << ':' << loc.line << '.' << loc.col;
+  socc::PresumedLocation pl = socc::Session::current ().sources.presumed (loc);
+  return os << pl.name << ':' << pl.line << '.' << pl.col;
 }
@@ -0,0 +1,53 @@
+/* diagnostics.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#ifndef _DIAGNOSTICS_HH
+#define _DIAGNOSTICS_HH
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include "location.hh"
+
+namespace socc
+{
+  enum class DiagnosticKind
+  {
+    Warning,
+    Error
+  };
+
+  /* A warning or error about a place in the source. OPTION is the flag
+     that controls a warning, if there is one. */
+  struct Diagnostic
+  {
+    DiagnosticKind kind;
+    Location loc;
+    std::string message;
+    std::string option;
+  };
+
+  typedef std::function <void (const Diagnostic &)> DiagnosticHandler;
+
+  void print_diagnostic (std::ostream &os, const Diagnostic &diag,
+			 bool color);
+  void print_fatal_error (std::ostream &os, bool color, std::string msg,
+			  std::string option = "");
+  void fatal_error (std::string msg, std::string option = "");
+}
+
+#endif
@@ -0,0 +1,607 @@
+/* flat-ast-io.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include "flat-ast.hh"
+#include "session.hh"
+
+using namespace socc;
+
+/* Binary form of a flat AST, written by save and read back by load. The
+   file is a header followed by sections, each an array of fixed-size
+   little-endian records starting at a multiple of 8 bytes, so a mapped
+   file can be used in place. Nodes and extra operands are stored exactly
+   as in FlatAST, except that symbol operands are indices into the
+   SYMBOLS section, since symbol IDs differ between processes. Type
+   operands index TYPE_REFS, which points into TYPES, where each distinct
+   type appears once, after every type it refers to. The line map of the
+   source file is included, so locations print as they did when the file
+   was parsed. Files are only read back by the version that wrote them. */
+
+static const char AST_MAGIC[8] = {'S', 'O', 'C', 'C', 'A', 'S', 'T', '\0'};
+static constexpr uint32_t AST_VERSION = 1;
+static constexpr uint32_t AST_BYTE_ORDER = 0x01020304;
+
+enum Section
+{
+  NODES,
+  EXTRA,
+  ROOTS,
+  STRINGS,
+  SYMBOLS,
+  TYPES,
+  TYPE_LISTS,
+  TYPE_REFS,
+  LINES,
+  TABS,
+  BYTES,
+  NUM_SECTIONS
+};
+
+struct SectionEntry
+{
+  uint64_t offset;
+  uint64_t size;
+};
+
+/* A run of characters in the BYTES section */
+struct Span
+{
+  uint32_t offset;
+  uint32_t len;
+};
+
+struct AstHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  Span file_name;
+  uint32_t file_size;
+  uint32_t reserved;
+  SectionEntry sections[NUM_SECTIONS];
+};
+
+struct TypeRecord
+{
+  uint8_t type;
+  uint8_t storage;
+  uint8_t flags;
+  uint8_t primitive;
+  uint32_t pointer;
+  uint32_t list;
+  uint32_t count;
+  uint32_t struct_name;
+  uint32_t reserved;
+  uint64_t len;
+};
+
+enum TypeFlags : uint8_t
+{
+  TYPE_CONST = 1,
+  TYPE_VOLATILE = 2,
+  TYPE_UNSIGNED = 4,
+  TYPE_EMPTY_PARAMS = 8
+};
+
+static_assert (sizeof (FlatNode) == 16, "FlatNode layout changed");
+static_assert (sizeof (TypeRecord) == 32, "TypeRecord layout changed");
+
+/* Calls F on every operand of NODES and EXTRA that holds a symbol */
+
+template <typename F>
+static void
+for_each_symbol (std::vector <FlatNode> &nodes, std::vector <uint32_t> &extra,
+		 F f)
+{
+  for (FlatNode &n : nodes)
+    {
+      switch (n.kind)
+	{
+	case NodeKind::MemberAccess:
+	  f (n.b);
+	  break;
+	case NodeKind::Variable:
+	  f (n.a);
+	  break;
+	case NodeKind::VariableDeclaration:
+	case NodeKind::FuncDeclaration:
+	  f (extra[n.b]);
+	  break;
+	case NodeKind::FuncDefinition:
+	  f (extra[n.b]);
+	  for (uint32_t i = 0; i < extra[n.b + 2]; i++)
+	    f (extra[n.b + 4 + i * 2]);
+	  break;
+	default:
+	  break;
+	}
+    }
+}
+
+/* Checks that every operand of NODES that refers to another node, to a
+   range of EXTRA, to a string piece or to a type is in bounds, so a
+   corrupt file cannot send the printer outside the arrays. Children must
+   come before their parent, which also rules out cycles, and must be of
+   the kind their parent expects. Symbol operands are checked when they
+   are translated. */
+
+static bool
+check_nodes (const std::vector <FlatNode> &nodes,
+	     const std::vector <uint32_t> &extra,
+	     const std::vector <uint32_t> &roots, size_t num_strings,
+	     size_t num_types, uint32_t file_size)
+{
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      const FlatNode &n = nodes[i];
+      auto expr = [&nodes, i] (uint32_t index)
+	{
+	  return index < i && nodes[index].kind < NodeKind::ExprStmt;
+	};
+      auto stmt = [&nodes, i] (uint32_t index)
+	{
+	  return index < i && nodes[index].kind >= NodeKind::ExprStmt
+	    && nodes[index].kind != NodeKind::FuncDefinition;
+	};
+      auto range = [&extra] (uint64_t start, uint64_t len)
+	{
+	  return start <= extra.size () && len <= extra.size () - start;
+	};
+      if (n.offset > file_size)
+	return false;
+      switch (n.kind)
+	{
+	case NodeKind::String:
+	  if (n.a > num_strings || n.b > num_strings - n.a)
+	    return false;
+	  break;
+	case NodeKind::Integer:
+	case NodeKind::Variable:
+	  break;
+	case NodeKind::Call:
+	  if (!expr (n.a) || !range (n.b, 1)
+	      || !range (n.b, 1ULL + extra[n.b]))
+	    return false;
+	  for (uint32_t j = 0; j < extra[n.b]; j++)
+	    {
+	      if (!expr (extra[n.b + 1 + j]))
+		return false;
+	    }
+	  break;
+	case NodeKind::ArrayIndex:
+	  if (!expr (n.a) || !expr (n.b))
+	    return false;
+	  break;
+	case NodeKind::MemberAccess:
+	  if (!expr (n.a))
+	    return false;
+	  break;
+	case NodeKind::Unary:
+	  if (!expr (n.a) || n.op > (unsigned char) UnaryOperator::Address)
+	    return false;
+	  break;
+	case NodeKind::Binary:
+	  if (!expr (n.a) || !expr (n.b)
+	      || n.op > (unsigned char) BinaryOperator::AssignOr)
+	    return false;
+	  break;
+	case NodeKind::ExprStmt:
+	  if (!expr (n.a))
+	    return false;
+	  break;
+	case NodeKind::Return:
+	  if (n.a != FlatAST::NONE && !expr (n.a))
+	    return false;
+	  break;
+	case NodeKind::Block:
+	  if (!range (n.b, 1) || !range (n.b, 1ULL + extra[n.b]))
+	    return false;
+	  for (uint32_t j = 0; j < extra[n.b]; j++)
+	    {
+	      if (!stmt (extra[n.b + 1 + j]))
+		return false;
+	    }
+	  break;
+	case NodeKind::VariableDeclaration:
+	  if (n.a >= num_types || !range (n.b, 2)
+	      || (extra[n.b + 1] != FlatAST::NONE && !expr (extra[n.b + 1])))
+	    return false;
+	  break;
+	case NodeKind::FuncDeclaration:
+	  if (n.a >= num_types || !range (n.b, 2)
+	      || !range (n.b, 2ULL + extra[n.b + 1]))
+	    return false;
+	  for (uint32_t j = 0; j < extra[n.b + 1]; j++)
+	    {
+	      if (extra[n.b + 2 + j] >= num_types)
+		return false;
+	    }
+	  break;
+	case NodeKind::FuncDefinition:
+	  if (n.a >= num_types || !range (n.b, 3)
+	      || !range (n.b, 3ULL + 2ULL * extra[n.b + 2])
+	      || extra[n.b + 1] >= i
+	      || nodes[extra[n.b + 1]].kind != NodeKind::Block)
+	    return false;
+	  for (uint32_t j = 0; j < extra[n.b + 2]; j++)
+	    {
+	      if (extra[n.b + 3 + j * 2] >= num_types)
+		return false;
+	    }
+	  break;
+	default:
+	  return false;
+	}
+    }
+  for (uint32_t root : roots)
+    {
+      if (root >= nodes.size ()
+	  || nodes[root].kind < NodeKind::VariableDeclaration)
+	return false;
+    }
+  return true;
+}
+
+namespace
+{
+  class AstWriter
+  {
+    std::unordered_map <uint32_t, uint32_t> symbol_ids;
+    std::unordered_map <TypePtr, uint32_t> type_ids;
+
+  public:
+    std::vector <Span> symbols;
+    std::vector <TypeRecord> types;
+    std::vector <uint32_t> type_lists;
+    std::vector <char> bytes;
+
+    AstWriter (void) { symbols.push_back ({0, 0}); }
+
+    Span
+    add_bytes (std::string_view str)
+    {
+      Span span = {(uint32_t) bytes.size (), (uint32_t) str.size ()};
+      bytes.insert (bytes.end (), str.begin (), str.end ());
+      return span;
+    }
+
+    uint32_t
+    add_symbol (uint32_t id)
+    {
+      if (id == 0)
+	return 0;
+      auto it = symbol_ids.find (id);
+      if (it != symbol_ids.end ())
+	return it->second;
+      uint32_t index = symbols.size ();
+      symbols.push_back (add_bytes (Symbol (id).str ()));
+      symbol_ids.emplace (id, index);
+      return index;
+    }
+
+    uint32_t
+    add_type (TypePtr type)
+    {
+      auto it = type_ids.find (type);
+      if (it != type_ids.end ())
+	return it->second;
+      TypeRecord rec = {};
+      rec.type = (uint8_t) type->type;
+      rec.storage = (uint8_t) type->storage;
+      rec.flags = (type->is_const ? TYPE_CONST : 0)
+	| (type->is_volatile ? TYPE_VOLATILE : 0)
+	| (type->is_unsigned ? TYPE_UNSIGNED : 0)
+	| (type->empty_params ? TYPE_EMPTY_PARAMS : 0);
+      rec.primitive = (uint8_t) type->primitive;
+      rec.pointer = type->pointer ? add_type (type->pointer) : FlatAST::NONE;
+      std::vector <uint32_t> list;
+      for (TypePtr param : type->params)
+	list.push_back (add_type (param));
+      rec.list = type_lists.size ();
+      rec.count = list.size ();
+      type_lists.insert (type_lists.end (), list.begin (), list.end ());
+      rec.struct_name = add_symbol (type->struct_name.value ());
+      rec.len = type->len;
+      uint32_t index = types.size ();
+      types.push_back (rec);
+      type_ids.emplace (type, index);
+      return index;
+    }
+  };
+}
+
+template <typename T>
+static void
+put_section (std::vector <char> &out, AstHeader &header, Section section,
+	     const std::vector <T> &data)
+{
+  out.resize ((out.size () + 7) & ~(size_t) 7);
+  header.sections[section] = {out.size (), data.size () * sizeof (T)};
+  const char *p = (const char *) data.data ();
+  out.insert (out.end (), p, p + data.size () * sizeof (T));
+}
+
+/* Writes the AST to PATH. Returns false with errno set on failure. */
+
+bool
+FlatAST::save (const std::string &path) const
+{
+  AstWriter w;
+  std::vector <FlatNode> out_nodes = nodes;
+  std::vector <uint32_t> out_extra = extra;
+  for_each_symbol (out_nodes, out_extra, [&w] (uint32_t &id)
+    {
+      id = w.add_symbol (id);
+    });
+  std::vector <Span> out_strings;
+  for (std::string_view str : strings)
+    out_strings.push_back (w.add_bytes (str));
+  std::vector <uint32_t> type_refs;
+  for (TypePtr type : types)
+    type_refs.push_back (w.add_type (type));
+
+  SourceManager &sources = Session::current ().sources;
+  LineMap map = sources.line_map (file);
+  AstHeader header = {};
+  memcpy (header.magic, AST_MAGIC, sizeof (AST_MAGIC));
+  header.version = AST_VERSION;
+  header.byte_order = AST_BYTE_ORDER;
+  header.file_name = w.add_bytes (sources.name (file));
+  header.file_size = map.size;
+
+  std::vector <char> out (sizeof (AstHeader));
+  put_section (out, header, NODES, out_nodes);
+  put_section (out, header, EXTRA, out_extra);
+  put_section (out, header, ROOTS, roots);
+  put_section (out, header, STRINGS, out_strings);
+  put_section (out, header, SYMBOLS, w.symbols);
+  put_section (out, header, TYPES, w.types);
+  put_section (out, header, TYPE_LISTS, w.type_lists);
+  put_section (out, header, TYPE_REFS, type_refs);
+  put_section (out, header, LINES, map.line_starts);
+  put_section (out, header, TABS, map.tabs);
+  put_section (out, header, BYTES, w.bytes);
+  memcpy (out.data (), &header, sizeof (AstHeader));
+
+  int fd = open (path.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd == -1)
+    return false;
+  const char *p = out.data ();
+  size_t left = out.size ();
+  while (left > 0)
+    {
+      ssize_t ret = write (fd, p, left);
+      if (ret < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  int saved_errno = errno;
+	  close (fd);
+	  errno = saved_errno;
+	  return false;
+	}
+      p += ret;
+      left -= ret;
+    }
+  return close (fd) == 0;
+}
+
+/* Reads an AST written by save into this one, which must be empty. The
+   file is mapped, and string pieces keep pointing into the mapping.
+   Nodes, extra operands and roots are copied out and checked, and every
+   symbol and type is rebuilt, before anything is returned, so a corrupt
+   file is rejected up front instead of when a bad index is followed.
+   Returns false and describes the problem in ERROR on failure. */
+
+bool
+FlatAST::load (const std::string &path, std::string &error)
+{
+  if (!backing.open (path))
+    {
+      error = strerror (errno);
+      return false;
+    }
+  const char *base = backing.begin ();
+  size_t size = backing.size ();
+  AstHeader header;
+  if (size < sizeof (AstHeader))
+    {
+      error = "file is truncated";
+      return false;
+    }
+  memcpy (&header, base, sizeof (AstHeader));
+  if (memcmp (header.magic, AST_MAGIC, sizeof (AST_MAGIC)) != 0)
+    {
+      error = "not an AST file";
+      return false;
+    }
+  if (header.version != AST_VERSION || header.byte_order != AST_BYTE_ORDER)
+    {
+      error = "AST file was written by an incompatible compiler";
+      return false;
+    }
+  for (const SectionEntry &section : header.sections)
+    {
+      if (section.offset % 8 != 0 || section.offset > size
+	  || section.size > size - section.offset)
+	{
+	  error = "file is truncated";
+	  return false;
+	}
+    }
+
+  auto get = [&header, base] (Section section, auto *&data, size_t &count)
+    {
+      typedef std::remove_reference_t <decltype (data)> Ptr;
+      data = (Ptr) (base + header.sections[section].offset);
+      count = header.sections[section].size / sizeof (*data);
+    };
+  const FlatNode *node_data;
+  const uint32_t *u32_data;
+  const Span *spans;
+  const TypeRecord *records;
+  const char *bytes;
+  size_t count;
+  size_t num_bytes;
+  get (BYTES, bytes, num_bytes);
+  auto text = [bytes, num_bytes] (Span span, std::string_view &str)
+    {
+      if (span.offset > num_bytes || span.len > num_bytes - span.offset)
+	return false;
+      str = std::string_view (bytes + span.offset, span.len);
+      return true;
+    };
+
+  get (NODES, node_data, count);
+  nodes.assign (node_data, node_data + count);
+  get (EXTRA, u32_data, count);
+  extra.assign (u32_data, u32_data + count);
+  get (ROOTS, u32_data, count);
+  roots.assign (u32_data, u32_data + count);
+  size_t num_strings;
+  size_t num_types;
+  get (STRINGS, spans, num_strings);
+  get (TYPE_REFS, u32_data, num_types);
+  if (!check_nodes (nodes, extra, roots, num_strings, num_types,
+		    header.file_size))
+    {
+      error = "AST file is corrupt";
+      return false;
+    }
+
+  get (SYMBOLS, spans, count);
+  std::vector <uint32_t> symbol_ids (count);
+  for (size_t i = 1; i < count; i++)
+    {
+      std::string_view str;
+      if (!text (spans[i], str))
+	{
+	  error = "AST file is corrupt";
+	  return false;
+	}
+      symbol_ids[i] = Symbol::intern (str).value ();
+    }
+  bool bad_symbol = false;
+  for_each_symbol (nodes, extra, [&symbol_ids, &bad_symbol] (uint32_t &id)
+    {
+      if (id < symbol_ids.size ())
+	id = symbol_ids[id];
+      else
+	bad_symbol = true;
+    });
+
+  get (STRINGS, spans, count);
+  strings.resize (count);
+  for (size_t i = 0; i < count; i++)
+    bad_symbol |= !text (spans[i], strings[i]);
+
+  get (TYPES, records, count);
+  const uint32_t *lists;
+  size_t num_lists;
+  get (TYPE_LISTS, lists, num_lists);
+  std::vector <TypePtr> record_types;
+  for (size_t i = 0; i < count; i++)
+    {
+      const TypeRecord &rec = records[i];
+      if ((rec.pointer != NONE && rec.pointer >= i) || rec.list > num_lists
+	  || rec.count > num_lists - rec.list
+	  || rec.struct_name >= symbol_ids.size ()
+	  || rec.type > (uint8_t) TypeType::Struct
+	  || rec.primitive > (uint8_t) PrimitiveType::Void
+	  || rec.storage > (uint8_t) StorageClass::Register
+	  || (rec.pointer == NONE
+	      && (rec.type == (uint8_t) TypeType::Pointer
+		  || rec.type == (uint8_t) TypeType::Array
+		  || rec.type == (uint8_t) TypeType::Function)))
+	{
+	  bad_symbol = true;
+	  break;
+	}
+      std::vector <TypePtr> params;
+      for (uint32_t j = 0; j < rec.count; j++)
+	{
+	  if (lists[rec.list + j] >= i)
+	    {
+	      error = "AST file is corrupt";
+	      return false;
+	    }
+	  params.push_back (record_types[lists[rec.list + j]]);
+	}
+      TypePtr pointer = rec.pointer == NONE ? nullptr
+	: record_types[rec.pointer];
+      TypePtr type = nullptr;
+      switch ((TypeType) rec.type)
+	{
+	case TypeType::Primitive:
+	  type = Type::get_primitive ((PrimitiveType) rec.primitive,
+				      rec.flags & TYPE_UNSIGNED);
+	  break;
+	case TypeType::Pointer:
+	  type = Type::get_pointer (pointer);
+	  break;
+	case TypeType::Array:
+	  type = Type::get_array (pointer, rec.len);
+	  break;
+	case TypeType::Function:
+	  type = Type::get_function (pointer, std::move (params),
+				     rec.flags & TYPE_EMPTY_PARAMS);
+	  break;
+	case TypeType::Struct:
+	  type = Type::get_struct (Symbol (symbol_ids[rec.struct_name]),
+				   std::move (params));
+	  break;
+	}
+      record_types.push_back (type->qualified (rec.flags & TYPE_CONST,
+					       rec.flags & TYPE_VOLATILE)
+			      ->with_storage ((StorageClass) rec.storage));
+    }
+  get (TYPE_REFS, u32_data, count);
+  types.clear ();
+  for (size_t i = 0; i < count && !bad_symbol; i++)
+    {
+      if (u32_data[i] >= record_types.size ())
+	bad_symbol = true;
+      else
+	types.push_back (record_types[u32_data[i]]);
+    }
+
+  std::string_view name;
+  if (bad_symbol || !text (header.file_name, name))
+    {
+      error = "AST file is corrupt";
+      return false;
+    }
+  LineMap map;
+  map.size = header.file_size;
+  get (LINES, u32_data, count);
+  map.line_starts.assign (u32_data, u32_data + count);
+  get (TABS, u32_data, count);
+  map.tabs.assign (u32_data, u32_data + count);
+  if (map.line_starts.empty ())
+    {
+      error = "AST file is corrupt";
+      return false;
+    }
+  file = Session::current ().sources.add_file (std::string (name),
+					       std::move (map));
+  return true;
+}
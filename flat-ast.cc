@@ -0,0 +1,408 @@
+/* flat-ast.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "context.hh"
+#include "flat-ast.hh"
+
+using namespace socc;
+
+uint32_t
+FlatAST::push (NodeKind kind, Location loc, uint32_t a, uint32_t b,
+	       unsigned char op, uint16_t flags)
+{
+  file = loc.file;
+  nodes.push_back ({kind, op, flags, loc.offset, a, b});
+  return nodes.size () - 1;
+}
+
+uint32_t
+FlatAST::add_type (const TypePtr &type)
+{
+  types.push_back (type);
+  return types.size () - 1;
+}
+
+/* Appends a count followed by the elements of LIST to the extra array and
+   returns the index of the count */
+
+uint32_t
+FlatAST::add_list (const std::vector <uint32_t> &list)
+{
+  uint32_t index = extra.size ();
+  extra.push_back (list.size ());
+  extra.insert (extra.end (), list.begin (), list.end ());
+  return index;
+}
+
+/* Adds expression NODE, whose operands have been added as CHILDREN */
+
+uint32_t
+FlatAST::add_expr (const ExprAST *node, const uint32_t *children)
+{
+  switch (node->kind)
+    {
+    case NodeKind::String:
+      {
+	const StringAST *e = cast <StringAST> (node);
+	uint32_t first = strings.size ();
+	strings.insert (strings.end (), e->pieces.begin (), e->pieces.end ());
+	return push (NodeKind::String, e->loc, first, e->pieces.size ());
+      }
+    case NodeKind::Integer:
+      {
+	const IntegerAST *e = cast <IntegerAST> (node);
+	return push (NodeKind::Integer, e->loc, e->value, e->value >> 32,
+		     (unsigned char) e->width, e->is_unsigned);
+      }
+    case NodeKind::Call:
+      {
+	const CallAST *e = cast <CallAST> (node);
+	std::vector <uint32_t> params (children + 1,
+				       children + 1 + e->params.size ());
+	return push (NodeKind::Call, e->loc, children[0], add_list (params));
+      }
+    case NodeKind::ArrayIndex:
+      return push (NodeKind::ArrayIndex, node->loc, children[0], children[1]);
+    case NodeKind::MemberAccess:
+      {
+	const MemberAccessAST *e = cast <MemberAccessAST> (node);
+	return push (NodeKind::MemberAccess, e->loc, children[0],
+		     e->member.value (), e->deref);
+      }
+    case NodeKind::Variable:
+      return push (NodeKind::Variable, node->loc,
+		   cast <VariableAST> (node)->name.value ());
+    case NodeKind::Unary:
+      return push (NodeKind::Unary, node->loc, children[0], 0,
+		   (unsigned char) cast <UnaryAST> (node)->op);
+    case NodeKind::Binary:
+      return push (NodeKind::Binary, node->loc, children[0], children[1],
+		   (unsigned char) cast <BinaryAST> (node)->op);
+    default:
+      return NONE;
+    }
+}
+
+/* Operands can be nested as deeply as an expression is long, so
+   expressions are flattened with a stack of the nodes whose operands are
+   still being added instead of by recursion. Operands are added in
+   order, each before its parent. */
+
+uint32_t
+FlatAST::visit_expr (const ExprAST *node)
+{
+  struct Pending
+  {
+    const ExprAST *node;
+    uint32_t next;
+  };
+  std::vector <Pending> stack {{node, 0}};
+  std::vector <uint32_t> added;
+  while (1)
+    {
+      Pending &top = stack.back ();
+      if (const ExprAST *child = top.node->child (top.next))
+	{
+	  top.next++;
+	  stack.push_back ({child, 0});
+	  continue;
+	}
+      size_t base = added.size () - top.next;
+      uint32_t index = add_expr (top.node, added.data () + base);
+      added.resize (base);
+      stack.pop_back ();
+      if (stack.empty ())
+	return index;
+      added.push_back (index);
+    }
+}
+
+uint32_t
+FlatAST::visit_expr_stmt (const ExprStmtAST *node)
+{
+  return push (NodeKind::ExprStmt, node->loc, visit (node->expr));
+}
+
+uint32_t
+FlatAST::visit_return (const ReturnAST *node)
+{
+  return push (NodeKind::Return, node->loc,
+	       node->value ? visit (node->value) : NONE);
+}
+
+uint32_t
+FlatAST::visit_block (const BlockAST *node)
+{
+  std::vector <uint32_t> body;
+  for (const StatementPtr &st : node->body)
+    body.push_back (visit (st));
+  return push (NodeKind::Block, node->loc, 0, add_list (body), 0,
+	       node->indent);
+}
+
+uint32_t
+FlatAST::visit_variable_declaration (const VariableDeclarationAST *node)
+{
+  uint32_t initval = node->initval ? visit (node->initval) : NONE;
+  uint32_t list = extra.size ();
+  extra.push_back (node->name.value ());
+  extra.push_back (initval);
+  return push (NodeKind::VariableDeclaration, node->loc,
+	       add_type (node->type), list);
+}
+
+uint32_t
+FlatAST::visit_func_declaration (const FuncDeclarationAST *node)
+{
+  uint32_t rettype = add_type (node->rettype);
+  uint32_t list = extra.size ();
+  extra.push_back (node->name.value ());
+  extra.push_back (node->params.size ());
+  for (const TypePtr &type : node->params)
+    extra.push_back (add_type (type));
+  return push (NodeKind::FuncDeclaration, node->loc, rettype, list, 0,
+	       node->empty_params);
+}
+
+uint32_t
+FlatAST::visit_func_definition (const FuncDefinitionAST *node)
+{
+  uint32_t body = visit (node->body);
+  uint32_t rettype = add_type (node->rettype);
+  uint32_t list = extra.size ();
+  extra.push_back (node->name.value ());
+  extra.push_back (body);
+  extra.push_back (node->params.size ());
+  for (const std::pair <TypePtr, Symbol> &param : node->params)
+    {
+      extra.push_back (add_type (param.first));
+      extra.push_back (param.second.value ());
+    }
+  return push (NodeKind::FuncDefinition, node->loc, rettype, list, 0,
+	       node->empty_params);
+}
+
+/* Bytes held by the flat form, not counting the types it shares with the
+   pointer-based tree */
+
+size_t
+FlatAST::memory_usage (void) const
+{
+  return nodes.capacity () * sizeof (FlatNode)
+    + extra.capacity () * sizeof (uint32_t)
+    + strings.capacity () * sizeof (std::string_view)
+    + types.capacity () * sizeof (TypePtr);
+}
+
+void
+FlatAST::print_declarator (Writer &os, uint32_t type,
+			   uint32_t name) const
+{
+  types[type]->print_declarator (os, Symbol (name));
+}
+
+namespace
+{
+  /* Something still to be printed: a node, or else text after SPACES
+     spaces, or else a name */
+  struct PrintItem
+  {
+    uint32_t node;
+    const char *text;
+    uint32_t name;
+    uint32_t spaces;
+  };
+}
+
+/* Prints the tree rooted at NODE exactly as AST::print prints the tree it
+   was built from. What is left to print is kept on a stack instead of
+   recursing into operands and statements, since a loaded tree may nest
+   blocks deeper than the parser would allow. */
+
+void
+FlatAST::print (Writer &os, uint32_t node) const
+{
+  std::vector <PrintItem> stack;
+  auto child = [&stack] (uint32_t index)
+    {
+      stack.push_back ({index, nullptr, 0, 0});
+    };
+  auto text = [&stack] (const char *str, uint32_t spaces = 0)
+    {
+      stack.push_back ({NONE, str, 0, spaces});
+    };
+  child (node);
+  while (!stack.empty ())
+    {
+      PrintItem item = stack.back ();
+      stack.pop_back ();
+      if (item.node == NONE)
+	{
+	  if (item.text)
+	    os.spaces (item.spaces) << item.text;
+	  else
+	    os << Symbol (item.name);
+	  continue;
+	}
+      const FlatNode &n = nodes[item.node];
+      switch (n.kind)
+	{
+	case NodeKind::String:
+	  os << '"';
+	  for (uint32_t i = 0; i < n.b; i++)
+	    print_escaped_chars (os, strings[n.a + i]);
+	  os << '"';
+	  break;
+	case NodeKind::Integer:
+	  {
+	    unsigned long long value = (unsigned long long) n.b << 32 | n.a;
+	    if (n.flags)
+	      os << value;
+	    else
+	      os << (long long) value;
+	  }
+	  if (n.flags)
+	    os << 'U';
+	  if ((IntLiteralWidth) n.op == IntLiteralWidth::Long)
+	    os << 'L';
+	  else if ((IntLiteralWidth) n.op == IntLiteralWidth::LongLong)
+	    os << "LL";
+	  break;
+	case NodeKind::Call:
+	  os << '(';
+	  text (")");
+	  for (uint32_t i = extra[n.b]; i > 0; i--)
+	    {
+	      child (extra[n.b + i]);
+	      if (i > 1)
+		text (", ");
+	    }
+	  text (") (");
+	  child (n.a);
+	  break;
+	case NodeKind::ArrayIndex:
+	  os << '(';
+	  text ("]");
+	  child (n.b);
+	  text (")[");
+	  child (n.a);
+	  break;
+	case NodeKind::MemberAccess:
+	  os << '(';
+	  stack.push_back ({NONE, nullptr, n.b, 0});
+	  text (n.op ? ")->" : ").");
+	  child (n.a);
+	  break;
+	case NodeKind::Variable:
+	  os << Symbol (n.a);
+	  break;
+	case NodeKind::Unary:
+	  {
+	    UnaryOperator op = (UnaryOperator) n.op;
+	    if (op == UnaryOperator::IncSuffix
+		|| op == UnaryOperator::DecSuffix)
+	      {
+		os << '(';
+		text (unary_operator_spelling (op));
+		text (")");
+	      }
+	    else
+	      {
+		os << unary_operator_spelling (op) << '(';
+		text (")");
+	      }
+	    child (n.a);
+	  }
+	  break;
+	case NodeKind::Binary:
+	  os << '(';
+	  text (")");
+	  child (n.b);
+	  text (" ");
+	  text (binary_operator_spelling ((BinaryOperator) n.op));
+	  text (" ");
+	  child (n.a);
+	  break;
+	case NodeKind::ExprStmt:
+	  text (";");
+	  child (n.a);
+	  break;
+	case NodeKind::Return:
+	  if (n.a == NONE)
+	    os << "return;";
+	  else
+	    {
+	      os << "return ";
+	      text (";");
+	      child (n.a);
+	    }
+	  break;
+	case NodeKind::Block:
+	  os << "{\n";
+	  text ("}", n.flags * 2);
+	  for (uint32_t i = extra[n.b]; i > 0; i--)
+	    {
+	      text ("\n");
+	      child (extra[n.b + i]);
+	      text ("", (n.flags + 1) * 2);
+	    }
+	  break;
+	case NodeKind::VariableDeclaration:
+	  print_declarator (os, n.a, extra[n.b]);
+	  text (";");
+	  if (extra[n.b + 1] != NONE)
+	    {
+	      os << " = ";
+	      child (extra[n.b + 1]);
+	    }
+	  break;
+	case NodeKind::FuncDeclaration:
+	  {
+	    print_declarator (os, n.a, extra[n.b]);
+	    os << " (";
+	    uint32_t count = extra[n.b + 1];
+	    if (count == 0)
+	      os << "void";
+	    for (uint32_t i = 0; i < count; i++)
+	      {
+		if (i > 0)
+		  os << ", ";
+		types[extra[n.b + 2 + i]]->print (os);
+	      }
+	    os << ");";
+	  }
+	  break;
+	case NodeKind::FuncDefinition:
+	  {
+	    types[n.a]->print (os);
+	    os << '\n' << Symbol (extra[n.b]) << " (";
+	    uint32_t count = extra[n.b + 2];
+	    if (count == 0)
+	      os << "void";
+	    for (uint32_t i = 0; i < count; i++)
+	      {
+		if (i > 0)
+		  os << ", ";
+		print_declarator (os, extra[n.b + 3 + i * 2],
+				  extra[n.b + 4 + i * 2]);
+	      }
+	    os << ")\n";
+	    child (extra[n.b + 1]);
+	  }
+	  break;
+	}
+    }
+}
@@ -0,0 +1,117 @@
+/* flat-ast.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _FLAT_AST_HH
+#define _FLAT_AST_HH
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "ast.hh"
+#include "source.hh"
+
+namespace socc
+{
+  /* One node of a flat AST. Children are referred to by their index in
+     FlatAST::nodes and are always stored before their parent. Operands
+     that do not fit in A and B live in FlatAST::extra, starting at the
+     index held in B:
+
+     String               A: first piece in strings  B: number of pieces
+     Integer              A, B: low and high halves of the value
+			  OP: IntLiteralWidth  FLAGS: unsigned
+     Call                 A: function  B: extra [count, params...]
+     ArrayIndex           A: array  B: index
+     MemberAccess         A: operand  B: member symbol  OP: dereference
+     Variable             A: symbol
+     Unary                A: operand  OP: UnaryOperator
+     Binary               A: lhs  B: rhs  OP: BinaryOperator
+     ExprStmt             A: expression
+     Return               A: value or NONE
+     Block                B: extra [count, statements...]  FLAGS: indent
+     VariableDeclaration  A: type  B: extra [name, initial value or NONE]
+     FuncDeclaration      A: return type  B: extra [name, count, types...]
+			  FLAGS: empty parameter list
+     FuncDefinition       A: return type
+			  B: extra [name, body, count, (type, name)...]
+			  FLAGS: empty parameter list */
+  struct FlatNode
+  {
+    NodeKind kind;
+    unsigned char op;
+    uint16_t flags;
+    uint32_t offset;
+    uint32_t a;
+    uint32_t b;
+  };
+
+  /* Compact, index-based copy of the trees of one file, built from the
+     pointer-based AST. Nodes sit in a single vector, so passes that visit
+     every node stream through memory instead of chasing pointers. */
+  class FlatAST : Visitor <FlatAST, uint32_t>
+  {
+    friend class Visitor <FlatAST, uint32_t>;
+
+    uint32_t push (NodeKind kind, Location loc, uint32_t a = 0,
+		   uint32_t b = 0, unsigned char op = 0, uint16_t flags = 0);
+    uint32_t add_type (const TypePtr &type);
+    uint32_t add_list (const std::vector <uint32_t> &list);
+    uint32_t add_expr (const ExprAST *node, const uint32_t *children);
+    uint32_t visit_expr (const ExprAST *node);
+    uint32_t visit_expr_stmt (const ExprStmtAST *node);
+    uint32_t visit_return (const ReturnAST *node);
+    uint32_t visit_block (const BlockAST *node);
+    uint32_t visit_variable_declaration (const VariableDeclarationAST *node);
+    uint32_t visit_func_declaration (const FuncDeclarationAST *node);
+    uint32_t visit_func_definition (const FuncDefinitionAST *node);
+    void print_declarator (Writer &os, uint32_t type,
+			   uint32_t name) const;
+
+  public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint32_t file;
+    std::vector <FlatNode> nodes;
+    std::vector <uint32_t> extra;
+    std::vector <std::string_view> strings;
+    std::vector <TypePtr> types;
+
+    /* Top-level declarations, in the order they were added */
+    std::vector <uint32_t> roots;
+
+    /* Holds the string pieces of an AST read by load */
+    SourceBuffer backing;
+
+    FlatAST (void) : file (0) {}
+
+    uint32_t
+    add (const FileScopeDeclAST &decl)
+    {
+      roots.push_back (visit (&decl));
+      return roots.back ();
+    }
+    Location location (uint32_t node) const
+    {
+      return Location (file, nodes[node].offset);
+    }
+    size_t memory_usage (void) const;
+    void print (Writer &os, uint32_t node) const;
+    bool save (const std::string &path) const;
+    bool load (const std::string &path, std::string &error);
+  };
+}
+
+#endif
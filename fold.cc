@@ -0,0 +1,414 @@
+/* fold.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <algorithm>
+#include <vector>
+#include "context.hh"
+
+using namespace socc;
+
+/* Integer constants are folded in the type C gives the expression. The
+   value of an IntegerAST is kept zero-extended to 64 bits if its type is
+   unsigned and sign-extended if it is signed, so signed values can be
+   read back by casting to long long. */
+
+static unsigned long long
+truncate (unsigned long long value, IntLiteralWidth width, bool is_unsigned)
+{
+  unsigned int bits = int_width_bits (width);
+  if (bits == 64)
+    return value;
+  unsigned long long mask = (1ULL << bits) - 1;
+  value &= mask;
+  if (!is_unsigned && (value >> (bits - 1)) & 1)
+    value |= ~mask;
+  return value;
+}
+
+/* Finds the type of a binary operation on A and B after the usual
+   arithmetic conversions. Every width is at least as wide as int, so the
+   integer promotions never apply. */
+
+static void
+common_type (const IntegerAST *a, const IntegerAST *b,
+	     IntLiteralWidth &width, bool &is_unsigned)
+{
+  if (a->is_unsigned == b->is_unsigned)
+    {
+      width = std::max (a->width, b->width);
+      is_unsigned = a->is_unsigned;
+      return;
+    }
+  const IntegerAST *u = a->is_unsigned ? a : b;
+  const IntegerAST *s = a->is_unsigned ? b : a;
+  width = std::max (u->width, s->width);
+  is_unsigned = u->width >= s->width
+    || int_width_bits (s->width) == int_width_bits (u->width);
+}
+
+/* Whether evaluating EXPR has no side effects, so it may be dropped.
+   Operands can be nested as deeply as an expression is long, so they are
+   walked with a worklist instead of by recursion. */
+
+static bool
+is_pure (const ExprAST *expr)
+{
+  std::vector <const ExprAST *> work {expr};
+  while (!work.empty ())
+    {
+      expr = work.back ();
+      work.pop_back ();
+      switch (expr->kind)
+	{
+	case NodeKind::String:
+	case NodeKind::Integer:
+	case NodeKind::Variable:
+	  break;
+	case NodeKind::ArrayIndex:
+	  {
+	    const ArrayIndexAST *e = cast <ArrayIndexAST> (expr);
+	    work.push_back (e->array);
+	    work.push_back (e->index);
+	  }
+	  break;
+	case NodeKind::MemberAccess:
+	  work.push_back (cast <MemberAccessAST> (expr)->operand);
+	  break;
+	case NodeKind::Unary:
+	  {
+	    const UnaryAST *e = cast <UnaryAST> (expr);
+	    switch (e->op)
+	      {
+	      case UnaryOperator::IncSuffix:
+	      case UnaryOperator::IncPrefix:
+	      case UnaryOperator::DecSuffix:
+	      case UnaryOperator::DecPrefix:
+		return false;
+	      default:
+		work.push_back (e->operand);
+	      }
+	  }
+	  break;
+	case NodeKind::Binary:
+	  {
+	    const BinaryAST *e = cast <BinaryAST> (expr);
+	    if (e->op >= BinaryOperator::Assign)
+	      return false;
+	    work.push_back (e->lhs);
+	    work.push_back (e->rhs);
+	  }
+	  break;
+	default:
+	  return false;
+	}
+    }
+  return true;
+}
+
+/* Whether EXPR always evaluates to 0 or 1 */
+
+static bool
+is_boolean (const ExprAST *expr)
+{
+  if (const UnaryAST *e = dyn_cast <UnaryAST> (expr))
+    return e->op == UnaryOperator::LogicalNot;
+  if (const BinaryAST *e = dyn_cast <BinaryAST> (expr))
+    return (e->op >= BinaryOperator::Lt && e->op <= BinaryOperator::Ne)
+      || e->op == BinaryOperator::LogicalAnd
+      || e->op == BinaryOperator::LogicalOr;
+  return false;
+}
+
+/* Whether EXPR may designate an object. An identity must not replace an
+   operation with such an operand by the operand itself, since the
+   result, which is not an lvalue, could then be assigned to. */
+
+static bool
+is_lvalue (const ExprAST *expr)
+{
+  switch (expr->kind)
+    {
+    case NodeKind::String:
+    case NodeKind::Variable:
+    case NodeKind::ArrayIndex:
+    case NodeKind::MemberAccess:
+      return true;
+    case NodeKind::Unary:
+      return cast <UnaryAST> (expr)->op == UnaryOperator::Dereference;
+    default:
+      return false;
+    }
+}
+
+/* Whether EXPR is the plain int constant VALUE. Identities are only
+   applied with such constants, as any other type could change the type
+   of the result. */
+
+static bool
+is_int_constant (const ExprAST *expr, unsigned long long value)
+{
+  const IntegerAST *e = dyn_cast <IntegerAST> (expr);
+  return e && e->value == value && e->width == IntLiteralWidth::Int
+    && !e->is_unsigned;
+}
+
+ExprPtr
+Context::fold_unary (Location loc, UnaryOperator op, ExprPtr operand)
+{
+  if (op == UnaryOperator::LogicalNot)
+    {
+      /* !!x is x when x is already 0 or 1 */
+      UnaryAST *inner = dyn_cast <UnaryAST> (operand);
+      if (inner && inner->op == UnaryOperator::LogicalNot
+	  && is_boolean (inner->operand))
+	return inner->operand;
+    }
+
+  IntegerAST *c = dyn_cast <IntegerAST> (operand);
+  if (c == nullptr)
+    return create <UnaryAST> (loc, op, operand);
+  unsigned long long value;
+  switch (op)
+    {
+    case UnaryOperator::Plus:
+      return c;
+    case UnaryOperator::Minus:
+      value = truncate (-c->value, c->width, c->is_unsigned);
+      if (!c->is_unsigned && value == c->value && value != 0)
+	warning (loc, "integer overflow in expression", "-Woverflow");
+      break;
+    case UnaryOperator::Not:
+      value = truncate (~c->value, c->width, c->is_unsigned);
+      break;
+    case UnaryOperator::LogicalNot:
+      return create <IntegerAST> (loc, c->value == 0, IntLiteralWidth::Int,
+				  false);
+    default:
+      return create <UnaryAST> (loc, op, operand);
+    }
+  return create <IntegerAST> (loc, value, c->width, c->is_unsigned);
+}
+
+/* Applies identities that need only one operand to be constant. Returns
+   null if none applies. */
+
+ExprPtr
+Context::simplify_binary (Location loc, BinaryOperator op, ExprPtr lhs,
+			  ExprPtr rhs)
+{
+  bool lhs_rvalue = !is_lvalue (lhs);
+  bool rhs_rvalue = !is_lvalue (rhs);
+  if (const IntegerAST *c = dyn_cast <IntegerAST> (lhs))
+    {
+      /* The right operand is never evaluated */
+      if (op == BinaryOperator::LogicalAnd && c->value == 0)
+	return create <IntegerAST> (loc, 0, IntLiteralWidth::Int, false);
+      if (op == BinaryOperator::LogicalOr && c->value != 0)
+	return create <IntegerAST> (loc, 1, IntLiteralWidth::Int, false);
+    }
+
+  if (is_int_constant (rhs, 0))
+    {
+      switch (op)
+	{
+	case BinaryOperator::Add:
+	case BinaryOperator::Sub:
+	case BinaryOperator::Shl:
+	case BinaryOperator::Shr:
+	case BinaryOperator::Xor:
+	case BinaryOperator::Or:
+	  if (lhs_rvalue)
+	    return lhs;
+	  break;
+	case BinaryOperator::Mul:
+	case BinaryOperator::And:
+	  if (is_pure (lhs))
+	    return rhs;
+	  break;
+	default:
+	  break;
+	}
+    }
+  else if (is_int_constant (rhs, 1))
+    {
+      if ((op == BinaryOperator::Mul || op == BinaryOperator::Div)
+	  && lhs_rvalue)
+	return lhs;
+    }
+
+  if (is_int_constant (lhs, 0))
+    {
+      switch (op)
+	{
+	case BinaryOperator::Add:
+	case BinaryOperator::Xor:
+	case BinaryOperator::Or:
+	  if (rhs_rvalue)
+	    return rhs;
+	  break;
+	case BinaryOperator::Mul:
+	case BinaryOperator::And:
+	  if (is_pure (rhs))
+	    return lhs;
+	  break;
+	default:
+	  break;
+	}
+    }
+  else if (is_int_constant (lhs, 1))
+    {
+      if (op == BinaryOperator::Mul && rhs_rvalue)
+	return rhs;
+    }
+  return nullptr;
+}
+
+ExprPtr
+Context::fold_binary (Location loc, BinaryOperator op, ExprPtr lhs,
+		      ExprPtr rhs)
+{
+  if (op >= BinaryOperator::Assign)
+    return create <BinaryAST> (loc, op, lhs, rhs);
+  IntegerAST *a = dyn_cast <IntegerAST> (lhs);
+  IntegerAST *b = dyn_cast <IntegerAST> (rhs);
+  if (a == nullptr || b == nullptr)
+    {
+      ExprPtr expr = simplify_binary (loc, op, lhs, rhs);
+      return expr ? expr : create <BinaryAST> (loc, op, lhs, rhs);
+    }
+
+  IntLiteralWidth width;
+  bool is_unsigned;
+  common_type (a, b, width, is_unsigned);
+  unsigned long long x = truncate (a->value, width, is_unsigned);
+  unsigned long long y = truncate (b->value, width, is_unsigned);
+  long long sx = x;
+  long long sy = y;
+  unsigned long long value;
+  bool overflow = false;
+  switch (op)
+    {
+    case BinaryOperator::Add:
+      value = x + y;
+      if (!is_unsigned)
+	overflow = __builtin_add_overflow (sx, sy, &sx);
+      break;
+    case BinaryOperator::Sub:
+      value = x - y;
+      if (!is_unsigned)
+	overflow = __builtin_sub_overflow (sx, sy, &sx);
+      break;
+    case BinaryOperator::Mul:
+      value = x * y;
+      if (!is_unsigned)
+	overflow = __builtin_mul_overflow (sx, sy, &sx);
+      break;
+    case BinaryOperator::Div:
+    case BinaryOperator::Mod:
+      if (y == 0)
+	{
+	  warning (loc, "division by zero", "-Wdiv-by-zero");
+	  return create <BinaryAST> (loc, op, lhs, rhs);
+	}
+      if (is_unsigned)
+	value = op == BinaryOperator::Div ? x / y : x % y;
+      else if (sy == -1)
+	{
+	  /* Negating the most negative value overflows, and % follows / */
+	  value = op == BinaryOperator::Div ? -x : 0;
+	  overflow = truncate (value, width, false) == x && x != 0;
+	}
+      else
+	value = op == BinaryOperator::Div ? sx / sy : sx % sy;
+      break;
+    case BinaryOperator::Shl:
+    case BinaryOperator::Shr:
+      {
+	/* The result has the type of the left operand */
+	width = a->width;
+	is_unsigned = a->is_unsigned;
+	x = a->value;
+	sx = x;
+	unsigned int bits = int_width_bits (width);
+	if (!b->is_unsigned && (long long) b->value < 0)
+	  {
+	    warning (loc, "shift count is negative",
+		     "-Wshift-count-negative");
+	    return create <BinaryAST> (loc, op, lhs, rhs);
+	  }
+	if (b->value >= bits)
+	  {
+	    warning (loc, "shift count is too large for the type",
+		     "-Wshift-count-overflow");
+	    return create <BinaryAST> (loc, op, lhs, rhs);
+	  }
+	if (op == BinaryOperator::Shr)
+	  value = is_unsigned ? x >> b->value : sx >> b->value;
+	else
+	  {
+	    value = x << b->value;
+	    overflow = !is_unsigned
+	      && (long long) truncate (value, width, false) >> b->value != sx;
+	  }
+      }
+      break;
+    case BinaryOperator::Lt:
+      value = is_unsigned ? x < y : sx < sy;
+      goto boolean;
+    case BinaryOperator::Le:
+      value = is_unsigned ? x <= y : sx <= sy;
+      goto boolean;
+    case BinaryOperator::Gt:
+      value = is_unsigned ? x > y : sx > sy;
+      goto boolean;
+    case BinaryOperator::Ge:
+      value = is_unsigned ? x >= y : sx >= sy;
+      goto boolean;
+    case BinaryOperator::Eq:
+      value = x == y;
+      goto boolean;
+    case BinaryOperator::Ne:
+      value = x != y;
+      goto boolean;
+    case BinaryOperator::And:
+      value = x & y;
+      break;
+    case BinaryOperator::Xor:
+      value = x ^ y;
+      break;
+    case BinaryOperator::Or:
+      value = x | y;
+      break;
+    case BinaryOperator::LogicalAnd:
+      value = a->value != 0 && b->value != 0;
+      goto boolean;
+    case BinaryOperator::LogicalOr:
+      value = a->value != 0 || b->value != 0;
+      goto boolean;
+    default:
+      return create <BinaryAST> (loc, op, lhs, rhs);
+    }
+
+  {
+    unsigned long long result = truncate (value, width, is_unsigned);
+    if (!is_unsigned && (overflow || result != value))
+      warning (loc, "integer overflow in expression", "-Woverflow");
+    return create <IntegerAST> (loc, result, width, is_unsigned);
+  }
+
+ boolean:
+  return create <IntegerAST> (loc, value, IntLiteralWidth::Int, false);
+}
@@ -14,13 +14,23 @@
    You should have received a copy of the GNU General Public License
    along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
 
-#include <cctype>
-#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 #include "context.hh"
+#include "scan.hh"
+#include "session.hh"
 
 using namespace socc;
 
-static std::unordered_map <std::string, TokenType> keywords = {
+struct Keyword
+{
+  const char *name;
+  TokenType type;
+  size_t len = 0;
+};
+
+static constexpr Keyword keyword_list[] = {
   {"auto", TokenType::KeywordAuto},
   {"break", TokenType::KeywordBreak},
   {"case", TokenType::KeywordCase},
@@ -56,32 +66,268 @@ static std::unordered_map <std::string, TokenType> keywords = {
   {"while", TokenType::KeywordWhile}
 };
 
-char
-Context::next_char (void)
+/* Keywords are recognized with a perfect hash over the first and last
+   characters and the length of a word. keyword_table is built at compile
+   time, and building it fails if two keywords share a slot. */
+
+static constexpr size_t KEYWORD_TABLE_SIZE = 128;
+
+static constexpr size_t
+keyword_hash (const char *str, size_t len)
 {
-  if (!char_stack.empty ())
+  return ((unsigned char) str[0] + (unsigned char) str[len - 1] + len * 15)
+    & (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct KeywordTable
+{
+  Keyword slots[KEYWORD_TABLE_SIZE];
+};
+
+static constexpr size_t
+keyword_length (const char *str)
+{
+  size_t len = 0;
+  while (str[len])
+    len++;
+  return len;
+}
+
+static constexpr KeywordTable
+build_keyword_table (void)
+{
+  KeywordTable table {};
+  for (const Keyword &kw : keyword_list)
     {
-      char c = char_stack.top ();
-      char_stack.pop ();
-      return c;
+      size_t len = keyword_length (kw.name);
+      Keyword &slot = table.slots[keyword_hash (kw.name, len)];
+      if (slot.name != nullptr)
+	throw "keyword hash collision";
+      slot = {kw.name, kw.type, len};
     }
-  else
+  return table;
+}
+
+static constexpr KeywordTable keyword_table = build_keyword_table ();
+
+bool
+socc::lookup_keyword (const char *str, size_t len, TokenType &type)
+{
+  if (len < 2 || len > 8)
+    return false;
+  const Keyword &slot = keyword_table.slots[keyword_hash (str, len)];
+  if (slot.len != len || memcmp (slot.name, str, len))
+    return false;
+  type = slot.type;
+  return true;
+}
+
+struct Punctuator
+{
+  const char *name;
+  TokenType type;
+  size_t len = 0;
+};
+
+/* Punctuators sharing a first character are listed together, longest
+   first, so the first one that matches is the longest match */
+
+static constexpr Punctuator punctuator_list[] = {
+  {"++", TokenType::Inc},
+  {"+=", TokenType::AssignPlus},
+  {"+", TokenType::Plus},
+  {"--", TokenType::Dec},
+  {"->", TokenType::Arrow},
+  {"-=", TokenType::AssignMinus},
+  {"-", TokenType::Minus},
+  {"<<=", TokenType::AssignShl},
+  {"<<", TokenType::Shl},
+  {"<=", TokenType::Le},
+  {"<", TokenType::Lt},
+  {">>=", TokenType::AssignShr},
+  {">>", TokenType::Shr},
+  {">=", TokenType::Ge},
+  {">", TokenType::Gt},
+  {"&&", TokenType::LogicalAnd},
+  {"&=", TokenType::AssignAnd},
+  {"&", TokenType::And},
+  {"||", TokenType::LogicalOr},
+  {"|=", TokenType::AssignOr},
+  {"|", TokenType::Or},
+  {"^=", TokenType::AssignXor},
+  {"^", TokenType::Xor},
+  {"==", TokenType::Eq},
+  {"=", TokenType::Assign},
+  {"!=", TokenType::Ne},
+  {"!", TokenType::LogicalNot},
+  {"*=", TokenType::AssignMul},
+  {"*", TokenType::Mul},
+  {"/=", TokenType::AssignDiv},
+  {"/", TokenType::Div},
+  {"%=", TokenType::AssignMod},
+  {"%", TokenType::Mod},
+  {"~", TokenType::Not},
+  {"(", TokenType::LeftParen},
+  {")", TokenType::RightParen},
+  {"[", TokenType::LeftBracket},
+  {"]", TokenType::RightBracket},
+  {"{", TokenType::LeftBrace},
+  {"}", TokenType::RightBrace},
+  {";", TokenType::Semicolon},
+  {",", TokenType::Comma},
+  {".", TokenType::Dot}
+};
+
+struct PunctuatorRange
+{
+  unsigned char first;
+  unsigned char count;
+};
+
+static constexpr size_t PUNCTUATOR_COUNT =
+  sizeof (punctuator_list) / sizeof (Punctuator);
+
+struct PunctuatorIndex
+{
+  PunctuatorRange ranges[256];
+  Punctuator list[PUNCTUATOR_COUNT];
+};
+
+/* Maps each first character to its run of punctuator_list and fills in
+   the lengths. Building the index fails at compile time unless every
+   operator character starts exactly one run, ending with the
+   single-character punctuator. */
+
+static constexpr PunctuatorIndex
+build_punctuator_index (void)
+{
+  PunctuatorIndex index {};
+  unsigned char prev = 0;
+  for (size_t i = 0; i < PUNCTUATOR_COUNT; i++)
     {
-      char c = stream.get ();
-      switch (c)
-	{
-	case '\n':
-	  currloc.line++;
-	  currloc.col = 0;
-	  break;
-	case '\t':
-	  currloc.col = ((currloc.col - 2) | 7) + 2;
-	  break;
-	default:
-	  currloc.col++;
-	}
-      return c;
+      const Punctuator &punct = punctuator_list[i];
+      unsigned char c = punct.name[0];
+      PunctuatorRange &range = index.ranges[c];
+      if (range.count == 0)
+	range.first = i;
+      else if (c != prev)
+	throw "punctuators with the same first character are not adjacent";
+      range.count++;
+      index.list[i] = {punct.name, punct.type, keyword_length (punct.name)};
+      prev = c;
+    }
+  for (int c = 0; c < 256; c++)
+    {
+      const PunctuatorRange &range = index.ranges[c];
+      if (char_is (c, CHAR_OPERATOR) != (range.count > 0))
+	throw "operator characters do not match punctuator_list";
+      size_t last = range.first + range.count - 1;
+      if (range.count > 0 && index.list[last].len != 1)
+	throw "punctuator run does not end with a single character";
+      for (size_t i = range.first; i <= last && range.count > 0; i++)
+	if (index.list[i].len > 3)
+	  throw "punctuators are at most three characters long";
+    }
+  return index;
+}
+
+static constexpr PunctuatorIndex punctuator_index = build_punctuator_index ();
+
+/* Contexts print their diagnostics to standard error until given a
+   handler */
+
+static void
+print_to_stderr (const Diagnostic &diag)
+{
+  print_diagnostic (std::cerr, diag, false);
+}
+
+Context::Context (std::string name, SourceBuffer buffer) :
+  token_pos (0), token_end (SIZE_MAX), peek_end (0), overrun (false),
+  arena (std::make_unique <Arena> ()), diagnostic_handler (print_to_stderr),
+  color (false), errors (0), indent (0), depth (0),
+  max_depth (DEFAULT_MAX_NESTING)
+{
+  SourceManager &sources = Session::current ().sources;
+  file = sources.add_file (name, std::move (buffer));
+  tokens = std::make_shared <TokenStream> (file);
+  const SourceBuffer &source = sources.buffer (file);
+  start = cursor = source.begin ();
+  limit = source.end ();
+}
+
+Context::Context (std::string name, std::istream &stream) :
+  token_pos (0), token_end (SIZE_MAX), peek_end (0), overrun (false),
+  arena (std::make_unique <Arena> ()), diagnostic_handler (print_to_stderr),
+  color (false), errors (0), indent (0), depth (0),
+  max_depth (DEFAULT_MAX_NESTING)
+{
+  SourceBuffer buffer;
+  buffer.read_stream (stream);
+  SourceManager &sources = Session::current ().sources;
+  file = sources.add_file (name, std::move (buffer));
+  tokens = std::make_shared <TokenStream> (file);
+  const SourceBuffer &source = sources.buffer (file);
+  start = cursor = source.begin ();
+  limit = source.end ();
+}
+
+/* Makes a context that parses tokens BEGIN to END of the stream lexed by
+   PARENT, passing its diagnostics to HANDLER. Names declared earlier in
+   the file are not visible to it. */
+
+Context::Context (const Context &parent, size_t begin, size_t end,
+		  DiagnosticHandler handler) :
+  file (parent.file), start (parent.start), cursor (parent.cursor),
+  limit (parent.limit), tokens (parent.tokens),
+  lex_diagnostics (parent.lex_diagnostics), token_pos (begin),
+  token_end (end), peek_end (begin), overrun (false),
+  arena (std::make_unique <Arena> ()),
+  diagnostic_handler (std::move (handler)), color (parent.color), errors (0),
+  indent (0), depth (0), max_depth (parent.max_depth)
+{
+}
+
+/* Location of the character most recently returned by next_char. A slice
+   does not lex, so it reports where the lexer would be had it lexed only
+   as far as the furthest token the parser has looked at. */
+
+Location
+Context::currloc (void) const
+{
+  size_t pos = cursor - start;
+  if (lex_diagnostics && peek_end > 0)
+    {
+      size_t i = std::min (peek_end, tokens->size ()) - 1;
+      if (tokens->kind (i) == TokenType::Eof)
+	pos = limit - start;
+      else
+	pos = tokens->location (i).offset + tokens->length (i);
     }
+  return Location (file, pos == 0 ? 0 : pos - 1);
+}
+
+char
+Context::next_char (void)
+{
+  if (cursor == limit)
+    return EOF;
+  return *cursor++;
+}
+
+char
+Context::peek_char (void)
+{
+  return cursor == limit ? EOF : *cursor;
+}
+
+/* Step back over the character C just returned by next_char */
+
+void
+Context::unget_char (char c)
+{
+  if (c != EOF || cursor != limit)
+    cursor--;
 }
 
 bool
@@ -91,113 +337,162 @@ Context::next_char_escaped (char &c)
   if (c != '\\')
     return false;
   c = next_char ();
-  switch (c)
+  if (decode_escape (c, c))
+    return true;
+  warning (currloc (), "unrecognized escape sequence " +
+	   bold (std::string ("\\") + c));
+  return false;
+}
+
+/* Scans an identifier or keyword whose first character has just been
+   consumed */
+
+Token
+Context::scan_word (void)
+{
+  Location loc = currloc ();
+  const char *begin = cursor - 1;
+  cursor = scan_ident (cursor);
+
+  TokenType type;
+  if (lookup_keyword (begin, cursor - begin, type))
+    return Token (type, loc);
+  else
+    return Token (TokenType::Identifier, loc,
+		  Symbol::intern (begin, cursor - begin));
+}
+
+/* Parses the suffix of an integer literal in [P, END): an optional u or U
+   and an optional l, L, ll or LL, in either order */
+
+static bool
+parse_int_suffix (const char *p, const char *end, bool &is_unsigned,
+		  IntLiteralWidth &width)
+{
+  bool seen_width = false;
+  is_unsigned = false;
+  width = IntLiteralWidth::Int;
+  while (p < end)
     {
-    case 'n':
-      c = '\n';
-      break;
-    case 't':
-      c = '\t';
-      break;
-    case 'r':
-      c = '\r';
-      break;
-    case 'a':
-      c = '\a';
-      break;
-    case 'b':
-      c = '\b';
-      break;
-    case 'f':
-      c = '\f';
-      break;
-    case 'v':
-      c = '\v';
-      break;
-    case '\\':
-      c = '\\';
-      break;
-    case '\'':
-      c = '\'';
-      break;
-    case '"':
-      c = '"';
-      break;
-    case '?':
-      c = '?';
-      break;
-    default:
-      warning (currloc, "unrecognized escape sequence " +
-	       bold (std::string ("\\" + c)));
-      return false;
+      if ((*p == 'u' || *p == 'U') && !is_unsigned)
+	{
+	  is_unsigned = true;
+	  p++;
+	}
+      else if ((*p == 'l' || *p == 'L') && !seen_width)
+	{
+	  seen_width = true;
+	  if (p + 1 < end && p[1] == *p)
+	    {
+	      width = IntLiteralWidth::LongLong;
+	      p += 2;
+	    }
+	  else
+	    {
+	      width = IntLiteralWidth::Long;
+	      p++;
+	    }
+	}
+      else
+	return false;
     }
   return true;
 }
 
-TokenPtr
-Context::scan_word (char c)
+static unsigned long long
+int_width_max (IntLiteralWidth width, bool is_unsigned)
+{
+  unsigned int bits = int_width_bits (width);
+  if (!is_unsigned)
+    bits--;
+  return ~0ULL >> (64 - bits);
+}
+
+/* Picks the type of an integer literal following C11 6.4.4.1: the first
+   of int, long and long long no narrower than the suffix that can hold
+   VALUE. Octal and hexadecimal literals may also become unsigned. */
+
+static bool
+pick_int_type (unsigned long long value, bool decimal, bool &is_unsigned,
+	       IntLiteralWidth &width)
 {
-  Location loc = currloc;
-  std::string str;
-  while (isalnum (c) || c == '_')
+  for (int w = (int) width; w <= (int) IntLiteralWidth::LongLong; w++)
     {
-      str += c;
-      c = next_char ();
+      IntLiteralWidth candidate = (IntLiteralWidth) w;
+      if (!is_unsigned && value <= int_width_max (candidate, false))
+	{
+	  width = candidate;
+	  return true;
+	}
+      if ((is_unsigned || !decimal)
+	  && value <= int_width_max (candidate, true))
+	{
+	  width = candidate;
+	  is_unsigned = true;
+	  return true;
+	}
     }
-  char_stack.push (c);
-
-  if (keywords.count (str))
-    return std::make_unique <Token> (keywords[str], loc);
-  else
-    return std::make_unique <Token> (TokenType::Identifier, loc, str);
+  return false;
 }
 
-TokenPtr
+Token
 Context::scan_number (char c)
 {
-  Location loc = currloc;
-  unsigned long long value = 0;
-  IntLiteralWidth width = IntLiteralWidth::Int;
-  while (isdigit (c))
+  Location loc = currloc ();
+  const char *p = cursor - 1;
+  unsigned int base = 10;
+  if (c == '0')
     {
-      value *= 10;
-      value += c - '0';
-      c = next_char ();
+      if (p[1] == 'x' || p[1] == 'X')
+	{
+	  base = 16;
+	  p += 2;
+	}
+      else if (p[1] == 'b' || p[1] == 'B')
+	{
+	  base = 2;
+	  p += 2;
+	}
+      else
+	base = 8;
     }
-  while (1)
+
+  unsigned long long value;
+  bool overflow;
+  const char *digits = p;
+  p = scan_integer (p, base, value, overflow);
+  const char *end = scan_ident (p);
+  cursor = end;
+
+  bool is_unsigned;
+  IntLiteralWidth width;
+  if (p == digits)
+    error (loc, "no digits in integer literal");
+  else if (base < 10 && char_is (*p, CHAR_DIGIT))
+    error (loc, std::string ("invalid digit ") + bold (std::string (1, *p))
+	   + (base == 8 ? " in octal literal" : " in binary literal"));
+  else if (!parse_int_suffix (p, end, is_unsigned, width))
+    error (loc, "invalid suffix " + bold (std::string (p, end - p))
+	   + " on integer literal");
+  else if (overflow)
+    error (loc, "integer literal is too large for its type");
+  else
     {
-      switch (c)
+      if (!pick_int_type (value, base == 10, is_unsigned, width))
 	{
-	case 'l':
-	case 'L':
-	  switch (width)
-	    {
-	    case IntLiteralWidth::Int:
-	      width = IntLiteralWidth::Long;
-	      break;
-	    case IntLiteralWidth::Long:
-	      width = IntLiteralWidth::LongLong;
-	      break;
-	    default:
-	      error (loc, "invalid integer literal");
-	    }
-	  break;
-	case 'u':
-	case 'U':
-	  break;
-	default:
-	  char_stack.push (c);
-	  return std::make_unique <Token> (TokenType::Integer, loc, value,
-					   width);
+	  warning (loc, "integer literal is so large that it is unsigned");
+	  is_unsigned = true;
+	  width = IntLiteralWidth::LongLong;
 	}
-      c = next_char ();
+      return Token (TokenType::Integer, loc, value, width, is_unsigned);
     }
+  return Token (TokenType::Integer, loc, 0, IntLiteralWidth::Int);
 }
 
-TokenPtr
+Token
 Context::scan_char (void)
 {
-  Location loc = currloc;
+  Location loc = currloc ();
   unsigned int val;
   char c;
   bool escape;
@@ -205,14 +500,12 @@ Context::scan_char (void)
   if (c == '\'' && !escape)
     {
       error (loc, "invalid empty character literal");
-      return std::make_unique <Token> (TokenType::Character, loc, 0,
-				       IntLiteralWidth::Int);
+      return Token (TokenType::Character, loc, 0, IntLiteralWidth::Int);
     }
   val = c;
   escape = next_char_escaped (c);
   if (c == '\'' && !escape)
-    return std::make_unique <Token> (TokenType::Character, loc, val,
-				     IntLiteralWidth::Int);
+    return Token (TokenType::Character, loc, val, IntLiteralWidth::Int);
   warning (loc, "multi-character literal");
   while (c != '\'' || escape)
     {
@@ -220,240 +513,188 @@ Context::scan_char (void)
       val |= c;
       escape = next_char_escaped (c);
     }
-  return std::make_unique <Token> (TokenType::Character, loc, val,
-				   IntLiteralWidth::Int);
+  return Token (TokenType::Character, loc, val, IntLiteralWidth::Int);
 }
 
-TokenPtr
+/* Finds the end of a string literal without copying it. Escapes are
+   only checked here, and decoded later by the token stream. */
+
+Token
 Context::scan_string (void)
 {
-  Location loc = currloc;
-  std::string str;
-  char c;
-  bool escape = next_char_escaped (c);
-  while (c != '"' || escape)
+  Location loc = currloc ();
+  const char *body = cursor;
+  const char *p = cursor;
+  while (1)
     {
-      if (!escape)
+      p = scan_string_end (p, limit);
+      if (p == limit)
 	{
-	  if (c == EOF)
-	    {
-	      error (currloc, "unexpected end of input in string literal");
-	      return nullptr;
-	    }
-	  else if (c == '\n')
-	    {
-	      error (currloc, "unexpected newline in string literal");
-	      break;
-	    }
+	  cursor = limit;
+	  error (currloc (), "unexpected end of input in string literal");
+	  return Token (TokenType::Eof, currloc ());
+	}
+      else if (*p == '"')
+	{
+	  cursor = p + 1;
+	  break;
+	}
+      else if (*p == '\n')
+	{
+	  cursor = p + 1;
+	  error (currloc (), "unexpected newline in string literal");
+	  break;
+	}
+
+      /* Backslash: a known escape is skipped whole, anything else leaves
+	 the next character to be examined normally */
+      char value;
+      if (p + 1 < limit && decode_escape (p[1], value))
+	p += 2;
+      else
+	{
+	  std::string seq ("\\");
+	  if (p + 1 < limit)
+	    seq += p[1];
+	  cursor = p + seq.size ();
+	  warning (currloc (), "unrecognized escape sequence " + bold (seq));
+	  p++;
 	}
-      str += c;
-      escape = next_char_escaped (c);
     }
-  return std::make_unique <Token> (TokenType::String, loc, str);
+  Token token (TokenType::String, loc);
+  token.str = tokens->add_string (std::string_view (body, p - body));
+  return token;
 }
 
-TokenPtr
-Context::next_token (void)
+Token
+Context::scan_punctuator (char c)
 {
-  if (!token_stack.empty ())
+  Location loc = currloc ();
+  const PunctuatorRange &range = punctuator_index.ranges[(unsigned char) c];
+  for (size_t i = range.first; i < range.first + range.count; i++)
     {
-      TokenPtr token = std::move (token_stack.top ());
-      token_stack.pop ();
-      return token;
+      const Punctuator &punct = punctuator_index.list[i];
+      size_t rest = punct.len - 1;
+      if ((rest < 1 || cursor[0] == punct.name[1])
+	  && (rest < 2 || cursor[1] == punct.name[2]))
+	{
+	  cursor += rest;
+	  return Token (punct.type, loc);
+	}
     }
+  __builtin_unreachable ();
+}
+
+Token
+Context::lex_token (void)
+{
   while (1)
     {
-      char c = next_char ();
-      while (isspace (c))
-	c = next_char ();
-      if (c == EOF)
-	return nullptr;
-
-      if (isalpha (c) || c == '_')
-	return scan_word (c);
-      else if (isdigit (c))
-	return scan_number (c);
-      else if (c == '\'')
-	return scan_char ();
-      else if (c == '"')
-	return scan_string ();
+      cursor = scan_space (cursor);
+      if (cursor == limit)
+	return Token (TokenType::Eof, currloc ());
 
-      Location loc = currloc;
-      switch (c)
+      char c = *cursor++;
+      unsigned char cls = char_class_table.classes[(unsigned char) c];
+      if (cls & CHAR_IDENT_START)
+	return scan_word ();
+      else if (cls & CHAR_DIGIT)
+	return scan_number (c);
+      else if (cls & CHAR_OPERATOR)
 	{
-	case '+':
-	  c = next_char ();
-	  switch (c)
-	    {
-	    case '+':
-	      return std::make_unique <Token> (TokenType::Inc, loc);
-	    case '=':
-	      return std::make_unique <Token> (TokenType::AssignPlus, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Plus, loc);
-	    }
-	case '-':
-	  c = next_char ();
-	  switch (c)
-	    {
-	    case '-':
-	      return std::make_unique <Token> (TokenType::Dec, loc);
-	    case '>':
-	      return std::make_unique <Token> (TokenType::Arrow, loc);
-	    case '=':
-	      return std::make_unique <Token> (TokenType::AssignMinus, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Minus, loc);
-	    }
-	case '<':
-	  c = next_char ();
-	  switch (c)
-	    {
-	    case '<':
-	      c = next_char ();
-	      if (c == '=')
-		return std::make_unique <Token> (TokenType::AssignShl, loc);
-	      else
-		{
-		  char_stack.push (c);
-		  return std::make_unique <Token> (TokenType::Shl, loc);
-		}
-	      break;
-	    case '=':
-	      return std::make_unique <Token> (TokenType::Le, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Lt, loc);
-	    }
-	case '>':
-	  c = next_char ();
-	  switch (c)
+	  if (c == '/' && *cursor == '/')
 	    {
-	    case '>':
-	      c = next_char ();
-	      if (c == '=')
-		return std::make_unique <Token> (TokenType::AssignShr, loc);
-	      else
-		{
-		  char_stack.push (c);
-		  return std::make_unique <Token> (TokenType::Shr, loc);
-		}
-	      break;
-	    case '=':
-	      return std::make_unique <Token> (TokenType::Ge, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Gt, loc);
-	    }
-	case '&':
-	  c = next_char ();
-	  switch (c)
-	    {
-	    case '&':
-	      return std::make_unique <Token> (TokenType::LogicalAnd, loc);
-	    case '=':
-	      return std::make_unique <Token> (TokenType::AssignAnd, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::And, loc);
-	    }
-	case '|':
-	  c = next_char ();
-	  switch (c)
-	    {
-	    case '|':
-	      return std::make_unique <Token> (TokenType::LogicalOr, loc);
-	    case '=':
-	      return std::make_unique <Token> (TokenType::AssignOr, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Or, loc);
-	    }
-	case '^':
-	  c = next_char ();
-	  if (c == '=')
-	    return std::make_unique <Token> (TokenType::AssignXor, loc);
-	  else
-	    {
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Xor, loc);
-	    }
-	case '=':
-	  c = next_char ();
-	  if (c == '=')
-	    return std::make_unique <Token> (TokenType::Eq, loc);
-	  else
-	    {
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Assign, loc);
-	    }
-	case '!':
-	  c = next_char ();
-	  if (c == '=')
-	    return std::make_unique <Token> (TokenType::Ne, loc);
-	  else
-	    {
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::LogicalNot, loc);
-	    }
-	case '*':
-	  c = next_char ();
-	  if (c == '=')
-	    return std::make_unique <Token> (TokenType::AssignMul, loc);
-	  else
-	    {
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Mul, loc);
-	    }
-	case '/':
-	  c = next_char ();
-	  switch (c)
-	    {
-	    case '/':
-	      do
-		c = next_char ();
-	      while (c != '\n' && c != EOF);
-	      char_stack.push (c);
+	      cursor = scan_line_end (cursor, limit);
 	      continue;
-	    case '=':
-	      return std::make_unique <Token> (TokenType::AssignDiv, loc);
-	    default:
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Div, loc);
-	    }
-	case '%':
-	  c = next_char ();
-	  if (c == '=')
-	    return std::make_unique <Token> (TokenType::AssignMod, loc);
-	  else
-	    {
-	      char_stack.push (c);
-	      return std::make_unique <Token> (TokenType::Mod, loc);
 	    }
-	case '~':
-	  return std::make_unique <Token> (TokenType::Not, loc);
-	case '(':
-	  return std::make_unique <Token> (TokenType::LeftParen, loc);
-	case ')':
-	  return std::make_unique <Token> (TokenType::RightParen, loc);
-	case '[':
-	  return std::make_unique <Token> (TokenType::LeftBracket, loc);
-	case ']':
-	  return std::make_unique <Token> (TokenType::RightBracket, loc);
-	case '{':
-	  return std::make_unique <Token> (TokenType::LeftBrace, loc);
-	case '}':
-	  return std::make_unique <Token> (TokenType::RightBrace, loc);
-	case ';':
-	  return std::make_unique <Token> (TokenType::Semicolon, loc);
-	case ',':
-	  return std::make_unique <Token> (TokenType::Comma, loc);
-	case '.':
-	  return std::make_unique <Token> (TokenType::Dot, loc);
-	default:
-	  error (loc, "unexpected character " + bold (std::string (1, c)));
+	  return scan_punctuator (c);
 	}
+      else if (c == '\'')
+	return scan_char ();
+      else if (c == '"')
+	return scan_string ();
+      error (currloc (), "unexpected character " +
+	     bold (std::string (1, c)));
+    }
+}
+
+/* Lexes the next token of the file onto the end of the stream */
+
+void
+Context::append_token (void)
+{
+  Token token = lex_token ();
+  uint32_t length = 0;
+  if (token.type != TokenType::Eof)
+    length = cursor - start - token.loc.offset;
+  tokens->push (token, length);
+}
+
+/* Reports the diagnostics kept from lexing ahead for the tokens from
+   peek_end up to END */
+
+void
+Context::report_lex_diagnostics (size_t end)
+{
+  auto it = std::lower_bound (lex_diagnostics->begin (),
+			      lex_diagnostics->end (), peek_end,
+			      [] (const LexDiagnostic &diag, size_t token)
+			      {
+				return diag.token < token;
+			      });
+  for (; it != lex_diagnostics->end () && it->token < end; it++)
+    diagnostic_handler (it->diag);
+}
+
+/* Returns the token N places ahead of the parser without consuming it.
+   Past the end of the file this is the final Eof token. */
+
+Token
+Context::peek_token (unsigned int n)
+{
+  size_t i = token_pos + n;
+  if (i >= token_end)
+    {
+      overrun = true;
+      return Token (TokenType::Eof, currloc ());
+    }
+  if (i >= peek_end)
+    {
+      if (lex_diagnostics)
+	report_lex_diagnostics (i + 1);
+      peek_end = i + 1;
     }
+  while (tokens->size () <= i)
+    {
+      if (tokens->complete ())
+	return tokens->get (tokens->size () - 1);
+      append_token ();
+    }
+  return tokens->get (i);
+}
+
+void
+Context::consume_token (void)
+{
+  if (peek_token ().type != TokenType::Eof)
+    token_pos++;
+}
+
+Token
+Context::next_token (void)
+{
+  Token token = peek_token ();
+  consume_token ();
+  return token;
+}
+
+/* Lexes the rest of the file and returns the whole token stream, which
+   ends with a single Eof token */
+
+const TokenStream &
+Context::tokenize (void)
+{
+  while (!tokens->complete ())
+    append_token ();
+  return *tokens;
 }
@@ -17,21 +17,21 @@
 #ifndef _LOCATION_HH
 #define _LOCATION_HH
 
+#include <cstdint>
 #include <ostream>
-#include <string>
 
 namespace socc
 {
+  /* A position in a file registered with the source manager. The line
+     and column are only computed when a location is printed. */
   class Location
   {
   public:
-    std::string name;
-    unsigned long line;
-    unsigned long col;
+    uint32_t file;
+    uint32_t offset;
 
-    explicit Location (std::string name) : name (name), line (1), col (0) {}
-    Location (std::string name, unsigned long line, unsigned long col) :
-      name (name), line (line), col (col) {}
+    Location (void) : file (0), offset (0) {}
+    Location (uint32_t file, uint32_t offset) : file (file), offset (offset) {}
   };
 }
 
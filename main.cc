@@ -14,20 +14,294 @@
    You should have received a copy of the GNU General Public License
    along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 #include "context.hh"
+#include "flat-ast.hh"
+#include "session.hh"
+
+struct Options
+{
+  bool color = false;
+  bool dump_tokens = false;
+  bool flat_ast = false;
+  bool syntax_only = false;
+  const char *emit_ast = nullptr;
+  unsigned int max_nesting = socc::Context::DEFAULT_MAX_NESTING;
+  unsigned int jobs = 1;
+};
+
+/* A translation unit compiled on a thread of its own. What it writes is
+   kept until every unit named before it has been written out, so the
+   output does not depend on which thread finishes first. */
+struct Unit
+{
+  const char *path;
+  std::string output;
+  std::ostringstream diagnostics;
+  bool failed = false;
+  bool done = false;
+
+  explicit Unit (const char *path) : path (path) {}
+};
+
+static void
+dump_tokens (socc::Context &ctx, socc::Writer &out)
+{
+  const socc::TokenStream &tokens = ctx.tokenize ();
+  for (size_t i = 0; i < tokens.size (); i++)
+    {
+      socc::Location loc = tokens.location (i);
+      const char *text =
+	socc::Session::current ().sources.buffer (loc.file).begin ();
+      out << loc << ": " << socc::token_type_name (tokens.kind (i));
+      if (tokens.length (i) > 0)
+	out << ' ';
+      out.write (text + loc.offset, tokens.length (i)) << '\n';
+    }
+}
+
+static unsigned int
+parse_jobs (const char *arg)
+{
+  char *end;
+  unsigned long n = strtoul (arg, &end, 10);
+  if (*arg == '\0' || *end != '\0' || n == 0 || n > 1024)
+    socc::fatal_error (std::string ("invalid number of jobs ") + arg);
+  return n;
+}
+
+/* Compiles the file at PATH, or standard input if PATH is "-", in a
+   session of its own. Returns false if the file could not be read or
+   had errors. */
+
+static bool
+compile (const char *path, const Options &opts, socc::Writer &out,
+	 std::ostream &diagnostics)
+{
+  socc::Session session;
+  socc::SessionGuard use_session (session);
+  bool from_stdin = strcmp (path, "-") == 0;
+  socc::SourceBuffer source;
+  if (from_stdin ? !source.read_fd (STDIN_FILENO) : !source.open (path))
+    {
+      socc::print_fatal_error (diagnostics, opts.color, from_stdin
+			       ? std::string ("failed to read input: ")
+			       + strerror (errno)
+			       : std::string ("cannot open ") + path + ": "
+			       + strerror (errno));
+      return false;
+    }
+  socc::Context ctx (from_stdin ? "<stdin>" : path, std::move (source));
+  ctx.set_max_nesting (opts.max_nesting);
+  ctx.set_color (opts.color);
+  ctx.set_diagnostic_handler ([&] (const socc::Diagnostic &diag)
+			      {
+				socc::print_diagnostic (diagnostics, diag,
+							opts.color);
+			      });
+  if (opts.dump_tokens)
+    {
+      dump_tokens (ctx, out);
+      return ctx.error_count () == 0;
+    }
+  socc::FlatAST flat;
+  auto output = [&] (socc::DeclHandle &decl)
+    {
+      if (opts.syntax_only)
+	return;
+      if (opts.emit_ast)
+	{
+	  flat.add (*decl);
+	  return;
+	}
+      out << decl->location () << ": ";
+      if (opts.flat_ast)
+	flat.print (out, flat.add (*decl));
+      else
+	out << *decl;
+      out << '\n';
+    };
+  if (opts.jobs > 1)
+    ctx.parse_all (opts.jobs, output);
+  else
+    {
+      while (socc::DeclHandle decl = ctx.next_decl ())
+	output (decl);
+    }
+  if (opts.emit_ast && !flat.save (opts.emit_ast))
+    {
+      socc::print_fatal_error (diagnostics, opts.color,
+			       std::string ("failed to write ") + opts.emit_ast
+			       + ": " + strerror (errno));
+      return false;
+    }
+  return ctx.error_count () == 0;
+}
+
+/* Compiles every unit on up to JOBS threads, writing the output and
+   diagnostics of each in the order the units were given as soon as it
+   and all units before it are done. Returns false if any failed. */
+
+static bool
+compile_units (std::vector <Unit> &units, const Options &opts,
+	       unsigned int jobs, socc::Writer &out)
+{
+  std::mutex lock;
+  std::condition_variable unit_done;
+  std::atomic <size_t> next_unit (0);
+  auto work = [&] (void)
+    {
+      size_t i;
+      while ((i = next_unit.fetch_add (1, std::memory_order_relaxed))
+	     < units.size ())
+	{
+	  Unit &unit = units[i];
+	  {
+	    socc::Writer unit_out (unit.output);
+	    unit.failed = !compile (unit.path, opts, unit_out,
+				    unit.diagnostics);
+	  }
+
+	  std::lock_guard <std::mutex> guard (lock);
+	  unit.done = true;
+	  unit_done.notify_all ();
+	}
+    };
+  std::vector <std::thread> threads;
+  for (unsigned int i = 0; i < jobs && i < units.size (); i++)
+    threads.emplace_back (work);
+
+  bool failed = false;
+  for (Unit &unit : units)
+    {
+      {
+	std::unique_lock <std::mutex> guard (lock);
+	unit_done.wait (guard, [&unit] { return unit.done; });
+      }
+      std::cerr << unit.diagnostics.str ();
+      out << unit.output;
+      unit.output = std::string ();
+      unit.diagnostics = std::ostringstream ();
+      failed |= unit.failed;
+    }
+  for (std::thread &thread : threads)
+    thread.join ();
+  return !failed;
+}
+
+/* Writes out what is left in OUT and closes the output file, if there is
+   one. Exits with a fatal error if any write failed, and otherwise
+   returns STATUS. */
+
+static int
+finish_output (socc::Writer &out, int fd, const char *output_path,
+	       int status)
+{
+  out.flush ();
+  int error = out.error ();
+  if (error == 0 && output_path && close (fd) != 0)
+    error = errno;
+  if (error != 0)
+    socc::fatal_error (std::string ("failed to write ")
+		       + (output_path ? output_path : "output") + ": "
+		       + strerror (error));
+  return status;
+}
 
 int
 main (int argc, char **argv)
 {
-  socc::init_console ();
-  socc::Context ctx ("<stdin>", std::cin);
-  while (1)
+  Options opts;
+  const char *output_path = nullptr;
+  const char *load_ast = nullptr;
+  unsigned int jobs = 1;
+  std::vector <const char *> inputs;
+  opts.color = isatty (STDERR_FILENO);
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "--dump-tokens") == 0)
+	opts.dump_tokens = true;
+      else if (strcmp (argv[i], "--flat-ast") == 0)
+	opts.flat_ast = true;
+      else if (strcmp (argv[i], "--syntax-only") == 0)
+	opts.syntax_only = true;
+      else if (strcmp (argv[i], "--emit-ast") == 0 && i + 1 < argc)
+	opts.emit_ast = argv[++i];
+      else if (strcmp (argv[i], "--load-ast") == 0 && i + 1 < argc)
+	load_ast = argv[++i];
+      else if (strcmp (argv[i], "--max-nesting") == 0 && i + 1 < argc)
+	{
+	  char *end;
+	  unsigned long n = strtoul (argv[++i], &end, 10);
+	  if (*argv[i] == '\0' || *end != '\0' || n == 0 || n > UINT_MAX)
+	    socc::fatal_error (std::string ("invalid nesting limit ") + argv[i]);
+	  opts.max_nesting = n;
+	}
+      else if ((strcmp (argv[i], "--jobs") == 0 || strcmp (argv[i], "-j") == 0)
+	       && i + 1 < argc)
+	jobs = parse_jobs (argv[++i]);
+      else if (strncmp (argv[i], "-j", 2) == 0 && argv[i][2] != '\0')
+	jobs = parse_jobs (argv[i] + 2);
+      else if (strcmp (argv[i], "-o") == 0 && i + 1 < argc)
+	output_path = argv[++i];
+      else if (argv[i][0] != '-' || argv[i][1] == '\0')
+	inputs.push_back (argv[i]);
+      else
+	socc::fatal_error (std::string ("unrecognized option ") + argv[i]);
+    }
+  if (inputs.empty ())
+    inputs.push_back ("-");
+  if (opts.emit_ast && inputs.size () > 1)
+    socc::fatal_error ("--emit-ast needs a single input file");
+
+  int fd = STDOUT_FILENO;
+  if (output_path)
+    {
+      fd = open (output_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd == -1)
+	socc::fatal_error (std::string ("cannot open ") + output_path + ": "
+			   + strerror (errno));
+    }
+  socc::Writer out (fd);
+  if (load_ast)
+    {
+      socc::FlatAST flat;
+      std::string error;
+      if (!flat.load (load_ast, error))
+	socc::fatal_error (std::string ("failed to load ") + load_ast + ": "
+			   + error);
+      for (uint32_t root : flat.roots)
+	{
+	  out << flat.location (root) << ": ";
+	  flat.print (out, root);
+	  out << '\n';
+	}
+      return finish_output (out, fd, output_path, 0);
+    }
+
+  /* A single unit parses its own declarations on all threads and writes
+     straight out. Otherwise units are spread over the threads, and those
+     left over are shared among the units. */
+  if (inputs.size () == 1)
     {
-      socc::FileScopeDeclPtr decl = ctx.next_decl ();
-      if (decl == nullptr)
-	break;
-      std::cout << decl->location () << ": " << *decl << std::endl;
+      opts.jobs = jobs;
+      bool ok = compile (inputs[0], opts, out, std::cerr);
+      return finish_output (out, fd, output_path, ok ? 0 : 1);
     }
-  return 0;
+  opts.jobs = std::max <size_t> (jobs / inputs.size (), 1);
+  std::vector <Unit> units (inputs.begin (), inputs.end ());
+  bool ok = compile_units (units, opts, jobs, out);
+  return finish_output (out, fd, output_path, ok ? 0 : 1);
 }
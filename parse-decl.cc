@@ -20,48 +20,45 @@
 using namespace socc;
 
 FileScopeDeclPtr
-Context::parse_decl_func (Location loc, TypePtr rettype, std::string name)
+Context::parse_decl_func (Location loc, TypePtr rettype, Symbol name)
 {
-  std::vector <std::pair <TypePtr, std::string>> params;
-  TokenPtr token = next_token ();
+  std::vector <std::pair <TypePtr, Symbol>> params;
   bool empty_params = true;
   bool try_define = false;
-  if (token != nullptr)
+  if (peek_token ().type == TokenType::KeywordVoid)
     {
-      if (token->type == TokenType::KeywordVoid)
+      const Token &lookahead = peek_token (1);
+      if (lookahead.type == TokenType::Eof)
 	{
-	  TokenPtr lookahead = next_token ();
-	  if (lookahead == nullptr)
-	    {
-	      error (currloc, "unexpected end of input, expected " +
-		     bold (")"));
-	      return nullptr;
-	    }
-	  else if (lookahead->type == TokenType::RightParen)
-	    {
-	      empty_params = true;
-	      try_define = true;
-	    }
-	  else
-	    token_stack.push (std::move (lookahead));
+	  error (currloc (), "unexpected end of input, expected " +
+		 bold (")"));
+	  return nullptr;
+	}
+      else if (lookahead.type == TokenType::RightParen)
+	{
+	  consume_token ();
+	  consume_token ();
+	  empty_params = true;
+	  try_define = true;
 	}
-      else if (token->type == TokenType::RightParen)
-	try_define = true;
+    }
+  else if (peek_token ().type == TokenType::RightParen)
+    {
+      consume_token ();
+      try_define = true;
     }
 
   if (!try_define)
     {
-      token_stack.push (std::move (token));
       while (1)
 	{
-	  token = next_token ();
-	  if (token == nullptr)
+	  Token token = peek_token ();
+	  if (token.type == TokenType::Eof)
 	    {
-	      error (currloc, "unexpected end of input, expected parameter");
+	      error (currloc (), "unexpected end of input, expected parameter");
 	      return nullptr;
 	    }
-	  Location loc = token->loc;
-	  token_stack.push (std::move (token));
+	  Location loc = token.loc;
 
 	  TypePtr type = parse_type (loc, TypeContext::FuncParam);
 	  if (type == nullptr)
@@ -69,121 +66,133 @@ Context::parse_decl_func (Location loc, TypePtr rettype, std::string name)
 	      error (loc, "expected a type in parameter list");
 	      do
 		token = next_token ();
-	      while (token != nullptr && token->type != TokenType::Comma
-		     && token->type != TokenType::RightParen);
-	      if (token == nullptr)
+	      while (token.type != TokenType::Eof
+		     && token.type != TokenType::Comma
+		     && token.type != TokenType::RightParen);
+	      if (token.type == TokenType::Eof)
 		return nullptr;
+	      if (token.type == TokenType::RightParen)
+		break;
+	      continue;
 	    }
-	  else
+
+	  Symbol param_name;
+	  token = peek_token ();
+	  if (token.type == TokenType::Eof)
 	    {
-	      std::string param_name;
-	      token = next_token ();
-	      if (token == nullptr)
+	      error (currloc (), "unexpected end of input, expected parameter");
+	      return nullptr;
+	    }
+	  else if (token.type == TokenType::Identifier)
+	    {
+	      param_name = token.sym;
+	      consume_token ();
+	      token = peek_token ();
+	      if (token.type == TokenType::Eof)
 		{
-		  error (currloc,
-			 "unexpected end of input, expected parameter");
+		  error (currloc (), "unexpected end of input, expected " +
+			 bold (",") + " or " + bold (")"));
 		  return nullptr;
 		}
-	      else if (token->type == TokenType::Identifier)
-		{
-		  param_name = token->str;
-		  token = next_token ();
-		  if (token == nullptr)
-		    {
-		      error (currloc, "unexpected end of input, expected " +
-			     bold (",") + " or " + bold (")"));
-		      return nullptr;
-		    }
-		}
-	      params.push_back (std::make_pair <TypePtr, std::string>
-				(std::move (type), std::move (param_name)));
 	    }
+	  params.push_back (std::make_pair (std::move (type), param_name));
 
-	  if (token->type == TokenType::RightParen)
-	    break;
-	  else if (token->type != TokenType::Comma)
+	  if (token.type == TokenType::RightParen)
 	    {
-	      error (token->loc, "expected " + bold (",") + " or " +
-		     bold (")"));
-	      token_stack.push (std::move (token));
+	      consume_token ();
+	      break;
 	    }
+	  else if (token.type == TokenType::Comma)
+	    consume_token ();
+	  else
+	    error (token.loc, "expected " + bold (",") + " or " + bold (")"));
 	}
     }
 
-  token = next_token ();
-  if (token == nullptr)
+  std::vector <TypePtr> types;
+  for (const std::pair <TypePtr, Symbol> &param : params)
+    types.push_back (param.first);
+  ordinary.insert (name, Type::get_function (rettype, types, empty_params));
+
+  Token token = peek_token ();
+  if (token.type == TokenType::Eof)
     {
-      error (currloc, "unexpected end of input, expected " + bold (";") +
+      error (currloc (), "unexpected end of input, expected " + bold (";") +
 	     " or " + bold ("{"));
       return nullptr;
     }
-  else if (token->type != TokenType::LeftBrace)
+  else if (token.type != TokenType::LeftBrace)
     {
-      if (token->type != TokenType::Semicolon)
-	{
-	  error (token->loc, "unexpected token, expected " + bold (";") +
-		 " or " + bold ("{"));
-	  token_stack.push (std::move (token));
-	}
-      std::vector <TypePtr> types;
-      for (const std::pair <TypePtr, std::string> &param : params)
-	types.push_back (std::move (param.first));
-      return std::make_unique <FuncDeclarationAST> (loc, std::move (rettype),
-						    name, std::move (types),
-						    empty_params);
+      if (token.type == TokenType::Semicolon)
+	consume_token ();
+      else
+	error (token.loc, "unexpected token, expected " + bold (";") +
+	       " or " + bold ("{"));
+      return create <FuncDeclarationAST> (loc, rettype, name,
+					  arena->copy_array (types.data (),
+							     types.size ()),
+					  empty_params);
     }
 
-  /* At this point, we are parsing a function definition */
-  std::unique_ptr <BlockAST> body = parse_stmt_block (token->loc);
+  /* At this point, we are parsing a function definition. The parameters
+     are visible in its body. */
+  consume_token ();
+  push_scope ();
+  for (const std::pair <TypePtr, Symbol> &param : params)
+    {
+      if (!param.second.empty ())
+	ordinary.insert (param.second, param.first);
+    }
+  BlockAST *body = parse_stmt_block (token.loc);
+  pop_scope ();
   if (body == nullptr)
     return nullptr;
-  return std::make_unique <FuncDefinitionAST> (loc, std::move (rettype),
-					       name, std::move (params),
-					       empty_params, std::move (body));
+  return create <FuncDefinitionAST> (loc, rettype, name,
+				     arena->copy_array (params.data (),
+							params.size ()),
+				     empty_params, body);
 }
 
 FileScopeDeclPtr
-Context::next_decl (void)
+Context::parse_decl (void)
 {
   while (1)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
+      Token token = peek_token ();
+      if (token.type == TokenType::Eof)
 	return nullptr;
-      Location loc = token->loc;
-      token_stack.push (std::move (token));
+      Location loc = token.loc;
 
       TypePtr type = parse_type (loc, TypeContext::FileScope);
       if (type == nullptr)
 	{
 	  token = next_token ();
-	  if (token == nullptr)
+	  if (token.type == TokenType::Eof)
 	    return nullptr;
-	  error (token->loc, "unexpected token, expected declaration");
+	  error (token.loc, "unexpected token, expected declaration");
 	}
       else
 	{
-	  token = next_token ();
-	  if (token == nullptr)
+	  token = peek_token ();
+	  if (token.type == TokenType::Eof)
 	    {
-	      error (currloc, "unexpected end of input, expected identifier");
+	      error (currloc (), "unexpected end of input, expected identifier");
 	      return nullptr;
 	    }
-	  TokenPtr lookahead = next_token ();
-	  if (lookahead != nullptr && lookahead->type == TokenType::LeftParen)
+	  if (peek_token (1).type == TokenType::LeftParen)
 	    {
-	      if (token->type != TokenType::Identifier)
+	      consume_token ();
+	      consume_token ();
+	      if (token.type != TokenType::Identifier)
 		{
-		  error (token->loc,
+		  error (token.loc,
 			 "expected an identifier in function declaration");
 		  continue;
 		}
-	      return parse_decl_func (token->loc, std::move (type), token->str);
+	      return parse_decl_func (token.loc, std::move (type), token.sym);
 	    }
 	  else
 	    {
-	      token_stack.push (std::move (lookahead));
-	      token_stack.push (std::move (token));
 	      if (type->type == TypeType::Primitive
 		  && type->primitive == PrimitiveType::Void)
 		{
@@ -191,19 +200,33 @@ Context::next_decl (void)
 			 " type is invalid in this context");
 		  continue;
 		}
-	      StatementPtr st =
-		parse_stmt_variable_declaration (loc, std::move (type));
-	      if (st == nullptr)
-		return nullptr;
-
-	      /* Convert StatementPtr to FileScopeDeclPtr */
-	      VariableDeclarationAST *rst =
-		dynamic_cast <VariableDeclarationAST *> (st.get ());
-	      FileScopeDeclPtr decl;
-	      st.release ();
-	      decl.reset (rst);
-	      return decl;
+	      consume_token ();
+	      if (token.type != TokenType::Identifier)
+		{
+		  error (token.loc,
+			 "expected identifier in variable declaration");
+		  if (!stmt_handle_parse_error ())
+		    return nullptr;
+		  continue;
+		}
+	      return cast <VariableDeclarationAST>
+		(parse_stmt_variable_declaration (loc, std::move (type),
+						  token.sym));
 	    }
 	}
     }
 }
+
+/* Parses the next top-level declaration. Its nodes are left in the
+   current arena, which moves into the returned handle. */
+
+DeclHandle
+Context::next_decl (void)
+{
+  FileScopeDeclPtr decl = parse_decl ();
+  if (decl == nullptr)
+    return DeclHandle ();
+  DeclHandle handle (decl, std::move (arena));
+  arena = std::make_unique <Arena> ();
+  return handle;
+}
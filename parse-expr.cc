@@ -14,155 +14,140 @@
    You should have received a copy of the GNU General Public License
    along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
 
+#include <array>
 #include <cctype>
-#include <iomanip>
-#include <unordered_map>
+#include <vector>
 #include "context.hh"
 
 using namespace socc;
 
-static std::unordered_map <TokenType, UnaryOperator> unary_op_map = {
-  {TokenType::Inc, UnaryOperator::IncPrefix},
-  {TokenType::Dec, UnaryOperator::DecPrefix},
-  {TokenType::Plus, UnaryOperator::Plus},
-  {TokenType::Minus, UnaryOperator::Minus},
-  {TokenType::Not, UnaryOperator::Not},
-  {TokenType::LogicalNot, UnaryOperator::LogicalNot},
-  {TokenType::Mul, UnaryOperator::Dereference},
-  {TokenType::And, UnaryOperator::Address}
-};
+/* Operator tables indexed by token type, so the parser decides what a
+   token means with a single load. A binary precedence of zero means the
+   token is not a binary operator, and a higher precedence binds tighter. */
 
-static std::unordered_map <TokenType, BinaryOperator> binary_op_map = {
-  {TokenType::Mul, BinaryOperator::Mul},
-  {TokenType::Div, BinaryOperator::Div},
-  {TokenType::Mod, BinaryOperator::Mod},
-  {TokenType::Plus, BinaryOperator::Add},
-  {TokenType::Minus, BinaryOperator::Sub},
-  {TokenType::Shl, BinaryOperator::Shl},
-  {TokenType::Shr, BinaryOperator::Shr},
-  {TokenType::Lt, BinaryOperator::Lt},
-  {TokenType::Le, BinaryOperator::Le},
-  {TokenType::Gt, BinaryOperator::Gt},
-  {TokenType::Ge, BinaryOperator::Ge},
-  {TokenType::Eq, BinaryOperator::Eq},
-  {TokenType::Ne, BinaryOperator::Ne},
-  {TokenType::And, BinaryOperator::And},
-  {TokenType::Xor, BinaryOperator::Xor},
-  {TokenType::Or, BinaryOperator::Or},
-  {TokenType::LogicalAnd, BinaryOperator::LogicalAnd},
-  {TokenType::LogicalOr, BinaryOperator::LogicalOr},
-  {TokenType::Assign, BinaryOperator::Assign},
-  {TokenType::AssignPlus, BinaryOperator::AssignAdd},
-  {TokenType::AssignMinus, BinaryOperator::AssignSub},
-  {TokenType::AssignMul, BinaryOperator::AssignMul},
-  {TokenType::AssignDiv, BinaryOperator::AssignDiv},
-  {TokenType::AssignMod, BinaryOperator::AssignMod},
-  {TokenType::AssignShl, BinaryOperator::AssignShl},
-  {TokenType::AssignShr, BinaryOperator::AssignShr},
-  {TokenType::AssignAnd, BinaryOperator::AssignAnd},
-  {TokenType::AssignXor, BinaryOperator::AssignXor},
-  {TokenType::AssignOr, BinaryOperator::AssignOr}
+struct BinaryOperatorInfo
+{
+  BinaryOperator op;
+  unsigned char prec;
+  bool right_assoc;
 };
 
-static std::unordered_map <BinaryOperator, unsigned int> binary_prec_map = {
-  {BinaryOperator::Mul, 11},
-  {BinaryOperator::Div, 11},
-  {BinaryOperator::Mod, 11},
-  {BinaryOperator::Add, 10},
-  {BinaryOperator::Sub, 10},
-  {BinaryOperator::Shl, 9},
-  {BinaryOperator::Shr, 9},
-  {BinaryOperator::Lt, 8},
-  {BinaryOperator::Le, 8},
-  {BinaryOperator::Gt, 8},
-  {BinaryOperator::Ge, 8},
-  {BinaryOperator::Eq, 7},
-  {BinaryOperator::Ne, 7},
-  {BinaryOperator::And, 6},
-  {BinaryOperator::Xor, 5},
-  {BinaryOperator::Or, 4},
-  {BinaryOperator::LogicalAnd, 3},
-  {BinaryOperator::LogicalOr, 2},
-  {BinaryOperator::Assign, 1},
-  {BinaryOperator::AssignAdd, 1},
-  {BinaryOperator::AssignSub, 1},
-  {BinaryOperator::AssignMul, 1},
-  {BinaryOperator::AssignDiv, 1},
-  {BinaryOperator::AssignMod, 1},
-  {BinaryOperator::AssignShl, 1},
-  {BinaryOperator::AssignShr, 1},
-  {BinaryOperator::AssignAnd, 1},
-  {BinaryOperator::AssignXor, 1},
-  {BinaryOperator::AssignOr, 1}
+struct UnaryOperatorInfo
+{
+  UnaryOperator op;
+  bool valid;
 };
 
-bool
-Context::expr_get_unary_op (TokenType type, UnaryOperator &op)
+static constexpr size_t NUM_TOKEN_TYPES = (size_t) TokenType::KeywordWhile + 1;
+
+static constexpr std::array <UnaryOperatorInfo, NUM_TOKEN_TYPES>
+make_unary_ops (void)
 {
-  if (unary_op_map.count (type))
+  std::array <UnaryOperatorInfo, NUM_TOKEN_TYPES> ops {};
+  auto set = [&ops] (TokenType type, UnaryOperator op)
     {
-      op = unary_op_map[type];
-      return true;
-    }
-  else
-    return false;
+      ops[(size_t) type] = {op, true};
+    };
+  set (TokenType::Inc, UnaryOperator::IncPrefix);
+  set (TokenType::Dec, UnaryOperator::DecPrefix);
+  set (TokenType::Plus, UnaryOperator::Plus);
+  set (TokenType::Minus, UnaryOperator::Minus);
+  set (TokenType::Not, UnaryOperator::Not);
+  set (TokenType::LogicalNot, UnaryOperator::LogicalNot);
+  set (TokenType::Mul, UnaryOperator::Dereference);
+  set (TokenType::And, UnaryOperator::Address);
+  return ops;
 }
 
-bool
-Context::expr_get_binary_op (TokenType type, BinaryOperator &op)
+static constexpr std::array <BinaryOperatorInfo, NUM_TOKEN_TYPES>
+make_binary_ops (void)
 {
-  if (binary_op_map.count (type))
+  std::array <BinaryOperatorInfo, NUM_TOKEN_TYPES> ops {};
+  auto set = [&ops] (TokenType type, BinaryOperator op, unsigned char prec)
     {
-      op = binary_op_map[type];
-      return true;
-    }
-  else
-    return false;
+      /* Only the assignment operators group right to left */
+      ops[(size_t) type] = {op, prec, prec == 1};
+    };
+  set (TokenType::Mul, BinaryOperator::Mul, 11);
+  set (TokenType::Div, BinaryOperator::Div, 11);
+  set (TokenType::Mod, BinaryOperator::Mod, 11);
+  set (TokenType::Plus, BinaryOperator::Add, 10);
+  set (TokenType::Minus, BinaryOperator::Sub, 10);
+  set (TokenType::Shl, BinaryOperator::Shl, 9);
+  set (TokenType::Shr, BinaryOperator::Shr, 9);
+  set (TokenType::Lt, BinaryOperator::Lt, 8);
+  set (TokenType::Le, BinaryOperator::Le, 8);
+  set (TokenType::Gt, BinaryOperator::Gt, 8);
+  set (TokenType::Ge, BinaryOperator::Ge, 8);
+  set (TokenType::Eq, BinaryOperator::Eq, 7);
+  set (TokenType::Ne, BinaryOperator::Ne, 7);
+  set (TokenType::And, BinaryOperator::And, 6);
+  set (TokenType::Xor, BinaryOperator::Xor, 5);
+  set (TokenType::Or, BinaryOperator::Or, 4);
+  set (TokenType::LogicalAnd, BinaryOperator::LogicalAnd, 3);
+  set (TokenType::LogicalOr, BinaryOperator::LogicalOr, 2);
+  set (TokenType::Assign, BinaryOperator::Assign, 1);
+  set (TokenType::AssignPlus, BinaryOperator::AssignAdd, 1);
+  set (TokenType::AssignMinus, BinaryOperator::AssignSub, 1);
+  set (TokenType::AssignMul, BinaryOperator::AssignMul, 1);
+  set (TokenType::AssignDiv, BinaryOperator::AssignDiv, 1);
+  set (TokenType::AssignMod, BinaryOperator::AssignMod, 1);
+  set (TokenType::AssignShl, BinaryOperator::AssignShl, 1);
+  set (TokenType::AssignShr, BinaryOperator::AssignShr, 1);
+  set (TokenType::AssignAnd, BinaryOperator::AssignAnd, 1);
+  set (TokenType::AssignXor, BinaryOperator::AssignXor, 1);
+  set (TokenType::AssignOr, BinaryOperator::AssignOr, 1);
+  return ops;
 }
 
-unsigned int
-Context::expr_get_binary_prec (BinaryOperator op)
-{
-  if (binary_prec_map.count (op))
-    return binary_prec_map[op];
-  else
-    return 0;
-}
+static constexpr std::array <UnaryOperatorInfo, NUM_TOKEN_TYPES> unary_ops =
+  make_unary_ops ();
+static constexpr std::array <BinaryOperatorInfo, NUM_TOKEN_TYPES> binary_ops =
+  make_binary_ops ();
 
-void
-Context::expr_call_build_params (std::vector <ExprPtr> &params)
+/* Parses the arguments of a call. VALID is cleared if an argument could
+   not be parsed because it nests too deeply. */
+
+ArenaArray <ExprPtr>
+Context::expr_call_build_params (bool &valid)
 {
-  TokenPtr token = next_token ();
-  if (token == nullptr)
+  const Token &token = peek_token ();
+  if (token.type == TokenType::Eof)
     {
-      error (currloc, "unexpected end of input, expected argument list");
-      return;
+      error (currloc (), "unexpected end of input, expected argument list");
+      return ArenaArray <ExprPtr> ();
+    }
+  else if (token.type == TokenType::RightParen)
+    {
+      consume_token ();
+      return ArenaArray <ExprPtr> (); /* Empty argument list */
     }
-  else if (token->type == TokenType::RightParen)
-    return; /* Empty argument list */
 
-  token_stack.push (std::move (token));
+  size_t base = expr_stack.size ();
   while (1)
     {
       ExprPtr param = next_expr ();
       if (param != nullptr)
-	params.push_back (std::move (param));
+	expr_stack.push_back (param);
+      else if (peek_token ().type != TokenType::Eof)
+	valid = false;
 
-      token = next_token ();
-      if (token == nullptr)
+      Token token = next_token ();
+      if (token.type == TokenType::Eof)
 	{
-	  error (currloc, "unexpected end of input, expected " + bold (")"));
-	  return;
+	  error (currloc (), "unexpected end of input, expected " + bold (")"));
+	  break;
 	}
-      if (token->type == TokenType::RightParen)
+      if (token.type == TokenType::RightParen)
 	break;
-      else if (token->type != TokenType::Comma)
+      else if (token.type != TokenType::Comma)
 	{
-	  error (token->loc, "expected " + bold (")") + " or " + bold (",") +
+	  error (token.loc, "expected " + bold (")") + " or " + bold (",") +
 		 " in argument list");
-	  return;
+	  break;
 	}
     }
+  return take_list (expr_stack, base);
 }
 
 ExprPtr
@@ -170,31 +155,36 @@ Context::parse_expr_atomic (void)
 {
   while (1)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
-	return nullptr;
-      switch (token->type)
+      Token token = next_token ();
+      switch (token.type)
 	{
+	case TokenType::Eof:
+	  return nullptr;
 	case TokenType::Integer:
-	  return std::make_unique <IntegerAST> (token->loc, token->num,
-						token->num_width);
+	  return create <IntegerAST> (token.loc, token.num, token.num_width,
+				      token.num_unsigned);
 	case TokenType::String:
-	  return std::make_unique <StringAST> (token->loc, token->str);
+	  {
+	    string_pieces.push_back (string_literal (token));
+	    while (peek_token ().type == TokenType::String)
+	      string_pieces.push_back (string_literal (next_token ()));
+	    return create <StringAST> (token.loc,
+				       take_list (string_pieces, 0));
+	  }
 	case TokenType::Identifier:
-	  return std::make_unique <VariableAST> (token->loc, token->str);
+	  return create <VariableAST> (token.loc, token.sym);
 	case TokenType::LeftParen:
 	  {
 	    ExprPtr expr = next_expr ();
-	    token = next_token ();
-	    if (token == nullptr)
-	      error (currloc, "unexpected end of input, expected " +
+	    const Token &next = peek_token ();
+	    if (next.type == TokenType::Eof)
+	      error (currloc (), "unexpected end of input, expected " +
 		     bold (")"));
-	    else if (token->type != TokenType::RightParen)
-	      {
-		error (token->loc, "expected " + bold (")") +
-		       " to match previous " + bold ("("));
-		token_stack.push (std::move (token));
-	      }
+	    else if (next.type == TokenType::RightParen)
+	      consume_token ();
+	    else
+	      error (next.loc, "expected " + bold (")") +
+		     " to match previous " + bold ("("));
 	    return expr;
 	  }
 	default:
@@ -203,383 +193,541 @@ Context::parse_expr_atomic (void)
     }
 }
 
+/* Parses a unary expression. Prefix operators are kept on unary_stack
+   until their operand is parsed and then applied innermost first, and
+   postfix operators are applied in a loop, so neither uses the C stack
+   in proportion to the length of the chain. */
+
 ExprPtr
 Context::parse_expr_basic (void)
 {
+  size_t base = unary_stack.size ();
+  ExprPtr expr = nullptr;
   while (1)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
-	return nullptr;
-      UnaryOperator op;
-      Location loc = token->loc;
-      if (expr_get_unary_op (token->type, op))
-	{
-	  ExprPtr operand = parse_expr_basic ();
-	  if (operand == nullptr)
-	    {
-	      error (loc, "invalid token, expected an expression");
-	      continue;
-	    }
-	  operand = parse_expr_suffix (std::move (operand));
-	  return std::make_unique <UnaryAST> (loc, op, std::move (operand));
-	}
-      else
+      Token token = peek_token ();
+      if (token.type == TokenType::Eof)
+	break;
+      const UnaryOperatorInfo &info = unary_ops[(size_t) token.type];
+      if (!info.valid)
 	{
-	  token_stack.push (std::move (token));
-	  ExprPtr expr = parse_expr_atomic ();
-	  if (expr == nullptr)
-	    return nullptr;
-	  return parse_expr_suffix (std::move (expr));
+	  expr = parse_expr_atomic ();
+	  if (expr != nullptr)
+	    expr = parse_expr_suffix (expr);
+	  break;
 	}
+      consume_token ();
+      unary_stack.push_back ({token.loc, info.op});
     }
+
+  if (expr == nullptr)
+    {
+      if (unary_stack.size () > base && peek_token ().type == TokenType::Eof)
+	error (unary_stack.back ().loc, "invalid token, expected an expression");
+      unary_stack.resize (base);
+      return nullptr;
+    }
+  while (unary_stack.size () > base)
+    {
+      const PendingUnary &pending = unary_stack.back ();
+      expr = fold_unary (pending.loc, pending.op, expr);
+      unary_stack.pop_back ();
+    }
+  return expr;
 }
 
 ExprPtr
 Context::parse_expr_suffix (ExprPtr expr)
 {
-  TokenPtr token = next_token ();
-  std::vector <ExprPtr> params;
-  if (token != nullptr)
+  while (1)
     {
-      switch (token->type)
+      TokenType type = peek_token ().type;
+      switch (type)
 	{
 	case TokenType::Dot:
 	case TokenType::Arrow:
-	  expr = parse_expr_member_access (std::move (expr),
-					   token->type == TokenType::Arrow);
-	  return parse_expr_suffix (std::move (expr));
+	  consume_token ();
+	  expr = parse_expr_member_access (expr, type == TokenType::Arrow);
+	  break;
 	case TokenType::LeftParen:
-	  expr_call_build_params (params);
-	  expr = std::make_unique <CallAST> (expr->location (),
-					     std::move (expr),
-					     std::move (params));
-	  return parse_expr_suffix (std::move (expr));
+	  {
+	    consume_token ();
+	    bool valid = true;
+	    ArenaArray <ExprPtr> params = expr_call_build_params (valid);
+	    if (!valid)
+	      return nullptr;
+	    expr = create <CallAST> (expr->location (), expr, params);
+	  }
+	  break;
 	case TokenType::LeftBracket:
-	  expr = parse_expr_array_index (std::move (expr));
-	  return parse_expr_suffix (std::move (expr));
+	  consume_token ();
+	  expr = parse_expr_array_index (expr);
+	  if (expr == nullptr)
+	    return nullptr;
+	  break;
 	case TokenType::Inc:
 	case TokenType::Dec:
-	  return std::make_unique <UnaryAST> (expr->location (),
-					      token->type == TokenType::Inc ?
-					      UnaryOperator::IncSuffix :
-					      UnaryOperator::DecSuffix,
-					      std::move (expr));
+	  consume_token ();
+	  expr = create <UnaryAST> (expr->location (),
+				    type == TokenType::Inc ?
+				    UnaryOperator::IncSuffix :
+				    UnaryOperator::DecSuffix, expr);
+	  break;
 	default:
-	  token_stack.push (std::move (token));
+	  return expr;
 	}
     }
-  return expr;
 }
 
 ExprPtr
 Context::parse_expr_member_access (ExprPtr expr, bool deref)
 {
-  TokenPtr token = next_token ();
-  if (token == nullptr)
+  const Token &token = peek_token ();
+  if (token.type == TokenType::Eof)
     {
       error (expr->location (), "unexpected end of input");
       return expr;
     }
-  if (token->type != TokenType::Identifier)
+  if (token.type != TokenType::Identifier)
     {
       error (expr->location (),
 	     "expected an identifier after member access operator");
-      token_stack.push (std::move (token));
       return expr;
     }
-  return std::make_unique <MemberAccessAST> (expr->location (),
-					     std::move (expr), token->str,
-					     deref);
+  Symbol member = token.sym;
+  consume_token ();
+  return create <MemberAccessAST> (expr->location (), expr, member, deref);
 }
 
 ExprPtr
 Context::parse_expr_array_index (ExprPtr expr)
 {
   ExprPtr index = next_expr ();
-  expr = std::make_unique <ArrayIndexAST> (expr->location (), std::move (expr),
-					   std::move (index));
-  TokenPtr token = next_token ();
-  if (token == nullptr)
-    error (currloc, "unexpected end of input, expected " + bold ("]"));
-  else if (token->type != TokenType::RightBracket)
-    {
-      error (currloc, "unexpected token, expected " + bold ("]"));
-      token_stack.push (std::move (token));
-    }
+  if (index != nullptr)
+    expr = create <ArrayIndexAST> (expr->location (), expr, index);
+  else if (peek_token ().type != TokenType::Eof)
+    expr = nullptr;
+  TokenType type = peek_token ().type;
+  if (type == TokenType::Eof)
+    error (currloc (), "unexpected end of input, expected " + bold ("]"));
+  else if (type == TokenType::RightBracket)
+    consume_token ();
+  else
+    error (currloc (), "unexpected token, expected " + bold ("]"));
   return expr;
 }
 
+/* Parses the binary operators after LHS by precedence. Each operator
+   waits on binary_stack with its left operand until the operator after
+   its right operand is seen. It is applied then if that operator binds
+   less tightly, or equally tightly and groups left to right, so a - b - c
+   is (a - b) - c while a = b = c is a = (b = c). */
+
 ExprPtr
-Context::parse_expr_binary (ExprPtr lhs, unsigned int minprec)
+Context::parse_expr_binary (ExprPtr lhs)
 {
+  size_t base = binary_stack.size ();
   while (1)
     {
-      BinaryOperator op;
-      TokenPtr token = next_token ();
-      if (token == nullptr)
-	return lhs;
-      if (!expr_get_binary_op (token->type, op))
-        {
-	  token_stack.push (std::move (token));
-	  return lhs;
-	}
-
-      unsigned int prec = expr_get_binary_prec (op);
-      if (prec < minprec)
+      const BinaryOperatorInfo &info = binary_ops[(size_t) peek_token ().type];
+      while (binary_stack.size () > base)
 	{
-	  token_stack.push (std::move (token));
-	  return lhs;
+	  const PendingBinary &top = binary_stack.back ();
+	  if (info.prec > top.prec
+	      || (info.prec == top.prec && info.right_assoc))
+	    break;
+	  lhs = fold_binary (top.lhs->location (), top.op, top.lhs, lhs);
+	  binary_stack.pop_back ();
 	}
+      if (info.prec == 0)
+	return lhs;
+      consume_token ();
 
       ExprPtr rhs = parse_expr_basic ();
       if (rhs == nullptr)
 	{
-	  error (currloc, "unexpected end of input, expected an expression");
+	  if (peek_token ().type != TokenType::Eof)
+	    {
+	      /* The operand nests too deeply, which has been reported */
+	      binary_stack.resize (base);
+	      return nullptr;
+	    }
+	  error (currloc (), "unexpected end of input, expected an expression");
+	  while (binary_stack.size () > base)
+	    {
+	      const PendingBinary &top = binary_stack.back ();
+	      lhs = fold_binary (top.lhs->location (), top.op, top.lhs, lhs);
+	      binary_stack.pop_back ();
+	    }
 	  return lhs;
 	}
-      token = next_token ();
-      if (token == nullptr || !binary_op_map.count (token->type))
-	{
-	  lhs = std::make_unique <BinaryAST> (lhs->location (), op,
-					      std::move (lhs), std::move (rhs));
-	  token_stack.push (std::move (token));
-	  continue;
-	}
-
-      /* Peek ahead at next token to see if it has higher precedence */
-      BinaryOperator new_op;
-      expr_get_binary_op (token->type, new_op);
-      unsigned int nextprec = expr_get_binary_prec (new_op);
-      token_stack.push (std::move (token));
-      if (prec < nextprec)
-	rhs = parse_expr_binary (std::move (rhs), prec + 1);
-      lhs = std::make_unique <BinaryAST> (lhs->location (), op,
-					  std::move (lhs), std::move (rhs));
+      binary_stack.push_back ({lhs, info.op, info.prec});
+      lhs = rhs;
     }
 }
 
 ExprPtr
 Context::next_expr (void)
 {
-  ExprPtr expr = parse_expr_basic ();
-  if (expr == nullptr)
+  if (!enter_nested ())
     return nullptr;
-  return parse_expr_binary (std::move (expr), 0);
-}
-
-void
-StringAST::print (std::ostream &os) const
-{
-  print_escaped_string (os, str);
+  ExprPtr expr = parse_expr_basic ();
+  if (expr != nullptr)
+    expr = parse_expr_binary (expr);
+  depth--;
+  return expr;
 }
 
-void
-IntegerAST::print (std::ostream &os) const
+std::string
+StringAST::value (void) const
 {
-  os << value;
-  if (width == IntLiteralWidth::Long)
-    os << 'L';
-  else if (width == IntLiteralWidth::LongLong)
-    os << "LL";
+  std::string str;
+  for (std::string_view piece : pieces)
+    str += piece;
+  return str;
 }
 
 void
-CallAST::print (std::ostream &os) const
+socc::print_escaped_chars (Writer &os, std::string_view str)
 {
-  os << '(' << *func << ") (";
-  if (!params.empty ())
+  for (char c : str)
     {
-      os << *params[0];
-      for (size_t i = 1; i < params.size (); i++)
-	os << ", " << *params[i];
+      if (isprint (c))
+	os << c;
+      else
+	os.put ('\\').number ((unsigned int) (int) c, 8);
     }
-  os << ')';
 }
 
 void
-ArrayIndexAST::print (std::ostream &os) const
+StringAST::print (Writer &os) const
 {
-  os << '(' << *array << ")[" << *index << ']';
+  os << '"';
+  for (std::string_view piece : pieces)
+    print_escaped_chars (os, piece);
+  os << '"';
 }
 
 void
-MemberAccessAST::print (std::ostream &os) const
+IntegerAST::print (Writer &os) const
 {
-  os << '(' << *operand << ')';
-  if (deref)
-    os << "->";
+  if (is_unsigned)
+    os << value;
   else
-    os << '.';
-  os << member;
+    os << (long long) value;
+  if (is_unsigned)
+    os << 'U';
+  if (width == IntLiteralWidth::Long)
+    os << 'L';
+  else if (width == IntLiteralWidth::LongLong)
+    os << "LL";
 }
 
 void
-VariableAST::print (std::ostream &os) const
+VariableAST::print (Writer &os) const
 {
   os << name;
 }
 
-void
-UnaryAST::print (std::ostream &os) const
+const char *
+socc::unary_operator_spelling (UnaryOperator op)
 {
-  if (op == UnaryOperator::IncSuffix || op == UnaryOperator::DecSuffix)
+  switch (op)
     {
-      os << '(' << *operand << ')';
-      if (op == UnaryOperator::IncSuffix)
-	os << "++";
-      else
-	os << "--";
-    }
-  else
-    {
-      switch (op)
-	{
-	case UnaryOperator::IncPrefix:
-	  os << "++";
-	  break;
-	case UnaryOperator::DecPrefix:
-	  os << "--";
-	  break;
-	case UnaryOperator::Plus:
-	  os << '+';
-	  break;
-	case UnaryOperator::Minus:
-	  os << '-';
-	  break;
-	case UnaryOperator::Not:
-	  os << '~';
-	  break;
-	case UnaryOperator::LogicalNot:
-	  os << '!';
-	  break;
-	case UnaryOperator::Dereference:
-	  os << '*';
-	  break;
-	case UnaryOperator::Address:
-	  os << '&';
-	  break;
-	default:
-	  return;
-	}
-      os << '(' << *operand << ')';
+    case UnaryOperator::IncSuffix:
+      return "++";
+    case UnaryOperator::IncPrefix:
+      return "++";
+    case UnaryOperator::DecSuffix:
+      return "--";
+    case UnaryOperator::DecPrefix:
+      return "--";
+    case UnaryOperator::Plus:
+      return "+";
+    case UnaryOperator::Minus:
+      return "-";
+    case UnaryOperator::Not:
+      return "~";
+    case UnaryOperator::LogicalNot:
+      return "!";
+    case UnaryOperator::Dereference:
+      return "*";
+    case UnaryOperator::Address:
+      return "&";
+    default:
+      return "";
     }
 }
 
-void
-BinaryAST::print (std::ostream &os) const
+const char *
+socc::binary_operator_spelling (BinaryOperator op)
 {
-  os << '(' << *lhs;
   switch (op)
     {
     case BinaryOperator::Add:
-      os << " + ";
-      break;
+      return "+";
     case BinaryOperator::Sub:
-      os << " - ";
-      break;
+      return "-";
     case BinaryOperator::Mul:
-      os << " * ";
-      break;
+      return "*";
     case BinaryOperator::Div:
-      os << " / ";
-      break;
+      return "/";
     case BinaryOperator::Mod:
-      os << " % ";
-      break;
+      return "%";
     case BinaryOperator::Shl:
-      os << " << ";
-      break;
+      return "<<";
     case BinaryOperator::Shr:
-      os << " >> ";
-      break;
+      return ">>";
     case BinaryOperator::Lt:
-      os << " < ";
-      break;
+      return "<";
     case BinaryOperator::Le:
-      os << " <= ";
-      break;
+      return "<=";
     case BinaryOperator::Gt:
-      os << " > ";
-      break;
+      return ">";
     case BinaryOperator::Ge:
-      os << " >= ";
-      break;
+      return ">=";
     case BinaryOperator::Eq:
-      os << " == ";
-      break;
+      return "==";
     case BinaryOperator::Ne:
-      os << " != ";
-      break;
+      return "!=";
     case BinaryOperator::And:
-      os << " & ";
-      break;
+      return "&";
     case BinaryOperator::Xor:
-      os << " ^ ";
-      break;
+      return "^";
     case BinaryOperator::Or:
-      os << " | ";
-      break;
+      return "|";
     case BinaryOperator::LogicalAnd:
-      os << " && ";
-      break;
+      return "&&";
     case BinaryOperator::LogicalOr:
-      os << " || ";
-      break;
+      return "||";
     case BinaryOperator::Assign:
-      os << " = ";
-      break;
+      return "=";
     case BinaryOperator::AssignAdd:
-      os << " += ";
-      break;
+      return "+=";
     case BinaryOperator::AssignSub:
-      os << " -= ";
-      break;
+      return "-=";
     case BinaryOperator::AssignMul:
-      os << " *= ";
-      break;
+      return "*=";
     case BinaryOperator::AssignDiv:
-      os << " /= ";
-      break;
+      return "/=";
     case BinaryOperator::AssignMod:
-      os << " %= ";
-      break;
+      return "%=";
     case BinaryOperator::AssignShl:
-      os << " <<= ";
-      break;
+      return "<<=";
     case BinaryOperator::AssignShr:
-      os << " >>= ";
-      break;
+      return ">>=";
     case BinaryOperator::AssignAnd:
-      os << " &= ";
-      break;
+      return "&=";
     case BinaryOperator::AssignXor:
-      os << " ^= ";
-      break;
+      return "^=";
     case BinaryOperator::AssignOr:
-      os << " |= ";
+      return "|=";
+    default:
+      return "";
+    }
+}
+
+/* Returns operand I of an expression, in the order they appear in the
+   source, or null if there are no more */
+
+ExprAST *
+ExprAST::child (size_t i) const
+{
+  switch (kind)
+    {
+    case NodeKind::Call:
+      {
+	const CallAST *e = cast <CallAST> (this);
+	if (i == 0)
+	  return e->func;
+	return i <= e->params.size () ? e->params[i - 1] : nullptr;
+      }
+    case NodeKind::ArrayIndex:
+      {
+	const ArrayIndexAST *e = cast <ArrayIndexAST> (this);
+	return i == 0 ? e->array : i == 1 ? e->index : nullptr;
+      }
+    case NodeKind::MemberAccess:
+      return i == 0 ? cast <MemberAccessAST> (this)->operand : nullptr;
+    case NodeKind::Unary:
+      return i == 0 ? cast <UnaryAST> (this)->operand : nullptr;
+    case NodeKind::Binary:
+      {
+	const BinaryAST *e = cast <BinaryAST> (this);
+	return i == 0 ? e->lhs : i == 1 ? e->rhs : nullptr;
+      }
+    default:
+      return nullptr;
+    }
+}
+
+namespace
+{
+  /* Something still to be printed: a node, or else text, or else a
+     name */
+  struct PrintItem
+  {
+    const AST *node;
+    const char *text;
+    Symbol name;
+  };
+}
+
+/* Prints an expression. Operands can be nested as deeply as an
+   expression is long, so what is left to print after the current node is
+   kept on a stack instead of in recursive calls. */
+
+static void
+print_expr (Writer &os, const ExprAST *expr)
+{
+  std::vector <PrintItem> stack;
+  auto node = [&stack] (const AST *n)
+    {
+      stack.push_back ({n, nullptr, Symbol ()});
+    };
+  auto text = [&stack] (const char *str)
+    {
+      stack.push_back ({nullptr, str, Symbol ()});
+    };
+  node (expr);
+  while (!stack.empty ())
+    {
+      PrintItem item = stack.back ();
+      stack.pop_back ();
+      if (item.node == nullptr)
+	{
+	  if (item.text)
+	    os << item.text;
+	  else
+	    os << item.name;
+	  continue;
+	}
+      switch (item.node->kind)
+	{
+	case NodeKind::Call:
+	  {
+	    const CallAST *e = cast <CallAST> (item.node);
+	    os << '(';
+	    text (")");
+	    for (size_t i = e->params.size (); i > 0; i--)
+	      {
+		node (e->params[i - 1]);
+		if (i > 1)
+		  text (", ");
+	      }
+	    text (") (");
+	    node (e->func);
+	  }
+	  break;
+	case NodeKind::ArrayIndex:
+	  {
+	    const ArrayIndexAST *e = cast <ArrayIndexAST> (item.node);
+	    os << '(';
+	    text ("]");
+	    node (e->index);
+	    text (")[");
+	    node (e->array);
+	  }
+	  break;
+	case NodeKind::MemberAccess:
+	  {
+	    const MemberAccessAST *e = cast <MemberAccessAST> (item.node);
+	    os << '(';
+	    stack.push_back ({nullptr, nullptr, e->member});
+	    text (e->deref ? ")->" : ").");
+	    node (e->operand);
+	  }
+	  break;
+	case NodeKind::Unary:
+	  {
+	    const UnaryAST *e = cast <UnaryAST> (item.node);
+	    if (e->op == UnaryOperator::IncSuffix
+		|| e->op == UnaryOperator::DecSuffix)
+	      {
+		os << '(';
+		text (unary_operator_spelling (e->op));
+		text (")");
+	      }
+	    else
+	      {
+		os << unary_operator_spelling (e->op) << '(';
+		text (")");
+	      }
+	    node (e->operand);
+	  }
+	  break;
+	case NodeKind::Binary:
+	  {
+	    const BinaryAST *e = cast <BinaryAST> (item.node);
+	    os << '(';
+	    text (")");
+	    node (e->rhs);
+	    text (" ");
+	    text (binary_operator_spelling (e->op));
+	    text (" ");
+	    node (e->lhs);
+	  }
+	  break;
+	default:
+	  item.node->print (os);
+	  break;
+	}
+    }
+}
+
+void
+AST::print (Writer &os) const
+{
+  switch (kind)
+    {
+    case NodeKind::String:
+      cast <StringAST> (this)->print (os);
+      break;
+    case NodeKind::Integer:
+      cast <IntegerAST> (this)->print (os);
+      break;
+    case NodeKind::Call:
+    case NodeKind::ArrayIndex:
+    case NodeKind::MemberAccess:
+    case NodeKind::Unary:
+    case NodeKind::Binary:
+      print_expr (os, cast <ExprAST> (this));
+      break;
+    case NodeKind::Variable:
+      cast <VariableAST> (this)->print (os);
+      break;
+    case NodeKind::ExprStmt:
+      cast <ExprStmtAST> (this)->print (os);
+      break;
+    case NodeKind::Return:
+      cast <ReturnAST> (this)->print (os);
+      break;
+    case NodeKind::Block:
+      cast <BlockAST> (this)->print (os);
+      break;
+    case NodeKind::VariableDeclaration:
+      cast <VariableDeclarationAST> (this)->print (os);
+      break;
+    case NodeKind::FuncDeclaration:
+      cast <FuncDeclarationAST> (this)->print (os);
+      break;
+    case NodeKind::FuncDefinition:
+      cast <FuncDefinitionAST> (this)->print (os);
       break;
     }
-  os << *rhs << ')';
 }
 
-std::ostream &
-operator<< (std::ostream &os, const AST &ast)
+Writer &
+operator<< (Writer &os, const AST &ast)
 {
   ast.print (os);
   return os;
 }
 
 void
-socc::print_escaped_string (std::ostream &os, std::string str)
+socc::print_escaped_string (Writer &os, std::string_view str)
 {
   os << '"';
-  for (char c : str)
-    {
-      if (isprint (c))
-	os << c;
-      else
-	os << '\\' << std::oct << (int) c << std::dec;
-    }
+  print_escaped_chars (os, str);
   os << '"';
 }
@@ -0,0 +1,205 @@
+/* parse-parallel.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "context.hh"
+#include "session.hh"
+
+using namespace socc;
+
+namespace
+{
+  /* A run of consecutive declarations parsed by one thread */
+  struct ParseTask
+  {
+    size_t begin;
+    size_t end;
+    std::vector <DeclHandle> decls;
+    std::vector <Diagnostic> diagnostics;
+    unsigned int errors = 0;
+    bool overrun = false;
+    bool stopped = false;
+    bool done = false;
+
+    ParseTask (size_t begin, size_t end) : begin (begin), end (end) {}
+  };
+}
+
+/* Guesses where the file-scope declarations from the current token on
+   end: at a semicolon outside braces, or at a closing brace that leaves
+   them. Returns half-open ranges of token indices. */
+
+std::vector <std::pair <size_t, size_t>>
+Context::split_decls (void)
+{
+  std::vector <std::pair <size_t, size_t>> decls;
+  size_t eof = tokens->size () - 1;
+  size_t begin = token_pos;
+  size_t braces = 0;
+  for (size_t i = token_pos; i < eof; i++)
+    {
+      switch (tokens->kind (i))
+	{
+	case TokenType::LeftBrace:
+	  braces++;
+	  continue;
+	case TokenType::RightBrace:
+	  if (braces == 0 || --braces > 0)
+	    continue;
+	  break;
+	case TokenType::Semicolon:
+	  if (braces > 0)
+	    continue;
+	  break;
+	default:
+	  continue;
+	}
+      decls.push_back ({begin, i + 1});
+      begin = i + 1;
+    }
+  if (begin < eof)
+    decls.push_back ({begin, eof});
+  return decls;
+}
+
+/* Parses the rest of the file on JOBS threads and passes each
+   declaration to HANDLE in source order, as calling next_decl until it
+   returns nothing would. Runs of declarations are parsed by slices that
+   see only their own tokens, and each run is handed over, along with its
+   diagnostics, once it and all runs before it are done. A slice that
+   looks past its end shows that the split was wrong there, so the file
+   is parsed again in order from the start of its run. */
+
+void
+Context::parse_all (unsigned int jobs,
+		    const std::function <void (DeclHandle &)> &handle)
+{
+  /* Lex the rest of the file, keeping the diagnostics of each token */
+  auto lexed = std::make_shared <std::vector <LexDiagnostic>> ();
+  DiagnosticHandler saved_handler = std::move (diagnostic_handler);
+  diagnostic_handler = [this, &lexed] (const Diagnostic &diag)
+    {
+      /* The token being lexed is not in the stream yet */
+      lexed->push_back ({tokens->size (), diag});
+    };
+  while (!tokens->complete ())
+    append_token ();
+  diagnostic_handler = std::move (saved_handler);
+  lex_diagnostics = lexed;
+  tokens->decode_strings ();
+
+  /* Keep runs large enough that starting one costs little, but give
+     every thread several to balance uneven declarations */
+  std::vector <std::pair <size_t, size_t>> decls = split_decls ();
+  size_t min_tokens = std::max <size_t> ((tokens->size () - token_pos)
+					 / (jobs * 16), 256);
+  std::vector <ParseTask> tasks;
+  for (size_t i = 0; i < decls.size ();)
+    {
+      size_t begin = decls[i].first;
+      size_t end;
+      do
+	end = decls[i++].second;
+      while (i < decls.size () && end - begin < min_tokens);
+      tasks.emplace_back (begin, end);
+    }
+  /* The last run ends at the end of the file, not before it */
+  if (!tasks.empty ())
+    tasks.back ().end = SIZE_MAX;
+
+  std::mutex lock;
+  std::condition_variable task_done;
+  std::atomic <size_t> next_task (0);
+  Session &session = Session::current ();
+  auto work = [&] (void)
+    {
+      SessionGuard use_session (session);
+      size_t i;
+      while ((i = next_task.fetch_add (1, std::memory_order_relaxed))
+	     < tasks.size ())
+	{
+	  ParseTask &task = tasks[i];
+	  Context slice (*this, task.begin, task.end,
+			 [&task] (const Diagnostic &diag)
+			 {
+			   task.diagnostics.push_back (diag);
+			 });
+	  while (slice.token_pos < task.end)
+	    {
+	      DeclHandle decl = slice.next_decl ();
+	      if (slice.overrun)
+		{
+		  task.overrun = true;
+		  break;
+		}
+	      if (!decl)
+		{
+		  task.stopped = true;
+		  break;
+		}
+	      task.decls.push_back (std::move (decl));
+	    }
+	  task.errors = slice.errors;
+
+	  std::lock_guard <std::mutex> guard (lock);
+	  task.done = true;
+	  task_done.notify_all ();
+	}
+    };
+  std::vector <std::thread> threads;
+  for (unsigned int i = 0; i < jobs && i < tasks.size (); i++)
+    threads.emplace_back (work);
+
+  ParseTask *overrun = nullptr;
+  for (ParseTask &task : tasks)
+    {
+      {
+	std::unique_lock <std::mutex> guard (lock);
+	task_done.wait (guard, [&task] { return task.done; });
+      }
+      if (task.overrun)
+	{
+	  overrun = &task;
+	  break;
+	}
+      for (const Diagnostic &diag : task.diagnostics)
+	diagnostic_handler (diag);
+      errors += task.errors;
+      for (DeclHandle &decl : task.decls)
+	handle (decl);
+      task.decls.clear ();
+      if (task.stopped)
+	break;
+    }
+
+  /* Keep the threads from starting runs that are no longer needed */
+  next_task.store (tasks.size ());
+  for (std::thread &thread : threads)
+    thread.join ();
+  if (overrun)
+    {
+      token_pos = overrun->begin;
+      peek_end = overrun->begin;
+      while (DeclHandle decl = next_decl ())
+	handle (decl);
+    }
+  else
+    token_pos = tokens->size () - 1;
+}
@@ -18,122 +18,182 @@
 
 using namespace socc;
 
-StatementPtr
+/* Skips tokens up to the first closing bracket that has no matching
+   opening one, or to the end of input */
+
+void
+Context::skip_nested (void)
+{
+  size_t level = 0;
+  while (1)
+    {
+      switch (peek_token ().type)
+	{
+	case TokenType::Eof:
+	  return;
+	case TokenType::LeftParen:
+	case TokenType::LeftBracket:
+	case TokenType::LeftBrace:
+	  level++;
+	  break;
+	case TokenType::RightParen:
+	case TokenType::RightBracket:
+	case TokenType::RightBrace:
+	  if (level == 0)
+	    return;
+	  level--;
+	  break;
+	default:
+	  break;
+	}
+      consume_token ();
+    }
+}
+
+/* Enters a construct that is parsed by recursion. If that would nest
+   deeper than the limit, reports an error, skips the rest of the
+   construct and returns false. */
+
+bool
+Context::enter_nested (void)
+{
+  if (depth < max_depth)
+    {
+      depth++;
+      return true;
+    }
+  error (peek_token ().loc, "nesting depth exceeds maximum of " +
+	 std::to_string (max_depth));
+  skip_nested ();
+  return false;
+}
+
+/* Skips tokens up to and including the next semicolon after a syntax
+   error. Returns false if the input ends first. */
+
+bool
 Context::stmt_handle_parse_error (void)
 {
   while (1)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
-	return nullptr;
-      if (token->type == TokenType::Semicolon)
-	break;
+      Token token = next_token ();
+      if (token.type == TokenType::Eof)
+	return false;
+      if (token.type == TokenType::Semicolon)
+	return true;
     }
-  return next_statement ();
 }
 
 StatementPtr
 Context::parse_stmt_return_expr (Location loc, bool ret)
 {
-  if (ret)
+  if (ret && peek_token ().type == TokenType::Semicolon)
     {
-      TokenPtr token = next_token ();
-      if (token != nullptr && token->type == TokenType::Semicolon)
-	return std::make_unique <ReturnAST> (loc, nullptr);
-      token_stack.push (std::move (token));
+      consume_token ();
+      return create <ReturnAST> (loc, nullptr);
     }
 
   ExprPtr expr = next_expr ();
   if (expr == nullptr)
-    return nullptr;
+    {
+      /* The error has been reported, unless the input ended */
+      if (peek_token ().type != TokenType::Eof)
+	stmt_handle_parse_error ();
+      return nullptr;
+    }
   StatementPtr st;
   if (ret)
-    st = std::make_unique <ReturnAST> (loc, std::move (expr));
+    st = create <ReturnAST> (loc, expr);
   else
-    st = std::make_unique <ExprStmtAST> (loc, std::move (expr));
+    st = create <ExprStmtAST> (loc, expr);
 
-  TokenPtr token = next_token ();
-  if (token == nullptr)
-    error (currloc, "unexpected end of input, expected " + bold (";"));
-  else if (token->type != TokenType::Semicolon)
-    {
-      error (token->loc, "expected " + bold (";") + " at end of statement");
-      token_stack.push (std::move (token));
-    }
+  const Token &token = peek_token ();
+  if (token.type == TokenType::Eof)
+    error (currloc (), "unexpected end of input, expected " + bold (";"));
+  else if (token.type == TokenType::Semicolon)
+    consume_token ();
+  else
+    error (token.loc, "expected " + bold (";") + " at end of statement");
   return st;
 }
 
-std::unique_ptr <BlockAST>
+BlockAST *
 Context::parse_stmt_block (Location loc)
 {
+  if (!enter_nested ())
+    {
+      if (peek_token ().type == TokenType::RightBrace)
+	consume_token ();
+      return create <BlockAST> (loc, ArenaArray <StatementPtr> (), indent);
+    }
   indent++;
-  std::vector <StatementPtr> body;
+  push_scope ();
+  size_t base = stmt_stack.size ();
   while (1)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
+      TokenType type = peek_token ().type;
+      if (type == TokenType::Eof)
 	{
-	  error (currloc, "unexpected end of input, expected " + bold ("}"));
-	  return std::make_unique <BlockAST> (loc, std::move (body), --indent);
+	  error (currloc (), "unexpected end of input, expected " + bold ("}"));
+	  break;
+	}
+      else if (type == TokenType::RightBrace)
+	{
+	  consume_token ();
+	  break;
 	}
-      else if (token->type == TokenType::RightBrace)
-	return std::make_unique <BlockAST> (loc, std::move (body), --indent);
 
-      token_stack.push (std::move (token));
       StatementPtr st = next_statement ();
       if (st == nullptr)
 	{
-	  error (currloc, "unexpected end of input, expected statement");
-	  return std::make_unique <BlockAST> (loc, std::move (body), --indent);
+	  error (currloc (), "unexpected end of input, expected statement");
+	  break;
 	}
-      body.push_back (std::move (st));
+      stmt_stack.push_back (st);
     }
+  pop_scope ();
+  depth--;
+  return create <BlockAST> (loc, take_list (stmt_stack, base), --indent);
 }
 
 StatementPtr
-Context::parse_stmt_variable_declaration (Location loc, TypePtr type)
+Context::parse_stmt_variable_declaration (Location loc, TypePtr type,
+					  Symbol name)
 {
-  TokenPtr token = next_token ();
-  if (token == nullptr)
-    {
-      error (currloc, "unexpected end of input, expected identifier");
-      return nullptr;
-    }
-  if (token->type != TokenType::Identifier)
+  VariableDeclarationAST *st =
+    create <VariableDeclarationAST> (loc, type, name);
+  ordinary.insert (name, type);
+  Token token = peek_token ();
+  if (token.type == TokenType::Eof)
     {
-      error (token->loc, "expected identifier in variable declaration");
-      return stmt_handle_parse_error ();
-    }
-
-  std::unique_ptr <VariableDeclarationAST> st =
-    std::make_unique <VariableDeclarationAST> (loc, type, token->str);
-  token = next_token ();
-  if (token == nullptr)
-    {
-      error (currloc, "unexpected end of input, expected " + bold (";"));
+      error (currloc (), "unexpected end of input, expected " + bold (";"));
       return st;
     }
-  else if (token->type == TokenType::Assign)
+  else if (token.type == TokenType::Assign)
     {
+      consume_token ();
       ExprPtr initval = next_expr ();
       if (initval == nullptr)
 	{
-	  error (currloc, "unexpected end of input, expected expression");
+	  if (peek_token ().type == TokenType::Eof)
+	    error (currloc (), "unexpected end of input, expected expression");
+	  else
+	    stmt_handle_parse_error ();
 	  return st;
 	}
-      token = next_token ();
-      if (token == nullptr)
+      token = peek_token ();
+      if (token.type == TokenType::Eof)
 	{
-	  error (currloc, "unexpected end of input, expected " + bold (";"));
+	  error (currloc (), "unexpected end of input, expected " +
+		 bold (";"));
 	  return st;
 	}
-      st->initval = std::move (initval);
-    }
-  if (token->type != TokenType::Semicolon)
-    {
-      error (token->loc, "unexpected token, expected " + bold (";"));
-      token_stack.push (std::move (token));
+      st->initval = initval;
     }
+  if (token.type == TokenType::Semicolon)
+    consume_token ();
+  else
+    error (token.loc, "unexpected token, expected " + bold (";"));
   return st;
 }
 
@@ -142,36 +202,65 @@ Context::next_statement (void)
 {
   while (1)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
-	return nullptr;
-      Location loc = token->loc;
-      switch (token->type)
+      const Token &token = peek_token ();
+      Location loc = token.loc;
+      switch (token.type)
 	{
+	case TokenType::Eof:
+	  return nullptr;
 	case TokenType::KeywordReturn:
-	  return parse_stmt_return_expr (loc, true);
+	  {
+	    consume_token ();
+	    StatementPtr st = parse_stmt_return_expr (loc, true);
+	    if (st || peek_token ().type == TokenType::Eof)
+	      return st;
+	  }
+	  break;
 	case TokenType::LeftBrace:
+	  consume_token ();
 	  return parse_stmt_block (loc);
 	case TokenType::Semicolon:
+	  consume_token ();
 	  break;
 	default:
-	  token_stack.push (std::move (token));
-	  TypePtr type = parse_type (loc, TypeContext::Local);
-	  if (type != nullptr)
-	    return parse_stmt_variable_declaration (loc, type);
-	  return parse_stmt_return_expr (loc, false);
+	  {
+	    TypePtr type = parse_type (loc, TypeContext::Local);
+	    if (type == nullptr)
+	      {
+		StatementPtr st = parse_stmt_return_expr (loc, false);
+		if (st || peek_token ().type == TokenType::Eof)
+		  return st;
+		break;
+	      }
+	    Token name = next_token ();
+	    if (name.type == TokenType::Eof)
+	      {
+		error (currloc (),
+		       "unexpected end of input, expected identifier");
+		return nullptr;
+	      }
+	    if (name.type == TokenType::Identifier)
+	      return parse_stmt_variable_declaration (loc, type, name.sym);
+
+	    /* Skip the declaration and parse the statement after it here,
+	       so that a run of bad declarations does not recurse */
+	    error (name.loc, "expected identifier in variable declaration");
+	    if (!stmt_handle_parse_error ())
+	      return nullptr;
+	  }
+	  break;
 	}
     }
 }
 
 void
-ExprStmtAST::print (std::ostream &os) const
+ExprStmtAST::print (Writer &os) const
 {
   os << *expr << ';';
 }
 
 void
-ReturnAST::print (std::ostream &os) const
+ReturnAST::print (Writer &os) const
 {
   if (value == nullptr)
     os << "return;";
@@ -180,69 +269,51 @@ ReturnAST::print (std::ostream &os) const
 }
 
 void
-BlockAST::print (std::ostream &os) const
+BlockAST::print (Writer &os) const
 {
   os << "{\n";
   for (const StatementPtr &st : body)
-    os << std::string ((indent + 1) * 2, ' ') << *st << '\n';
-  os << std::string (indent * 2, ' ') << '}';
+    os.spaces ((indent + 1) * 2) << *st << '\n';
+  os.spaces (indent * 2) << '}';
 }
 
 void
-VariableDeclarationAST::print (std::ostream &os) const
+VariableDeclarationAST::print (Writer &os) const
 {
-  std::string text = type->name ();
-  os << text;
-  if (text.back () != '*')
-    os << ' ';
-  os << name;
+  type->print_declarator (os, name);
   if (initval)
     os << " = " << *initval;
   os << ';';
 }
 
 void
-FuncDeclarationAST::print (std::ostream &os) const
+FuncDeclarationAST::print (Writer &os) const
 {
-  std::string text = rettype->name ();
-  os << text;
-  if (text.back () != '*')
-    os << ' ';
-  os << name << " (";
+  rettype->print_declarator (os, name);
+  os << " (";
   if (params.empty ())
     os << "void";
-  else
+  for (size_t i = 0; i < params.size (); i++)
     {
-      os << params[0]->name ();
-      for (size_t i = 1; i < params.size (); i++)
-	os << ", " << params[i]->name ();
+      if (i > 0)
+	os << ", ";
+      params[i]->print (os);
     }
   os << ");";
 }
 
 void
-FuncDefinitionAST::print (std::ostream &os) const
+FuncDefinitionAST::print (Writer &os) const
 {
-  std::string text = rettype->name ();
-  os << text << '\n' << name << " (";
+  rettype->print (os);
+  os << '\n' << name << " (";
   if (params.empty ())
     os << "void";
-  else
+  for (size_t i = 0; i < params.size (); i++)
     {
-      std::string text = params[0].first->name ();
-      os << text;
-      if (text.back () != '*')
-	os << ' ';
-      os << params[0].second;
-      for (size_t i = 1; i < params.size (); i++)
-	{
-	  os << ", ";
-	  text = params[i].first->name ();
-	  os << text;
-	  if (text.back () != '*')
-	    os << ' ';
-	  os << params[i].second;
-	}
+      if (i > 0)
+	os << ", ";
+      params[i].first->print_declarator (os, params[i].second);
     }
   os << ")\n" << *body;
 }
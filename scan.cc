@@ -0,0 +1,462 @@
+/* scan.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <cstdint>
+#include <cstring>
+#include "scan.hh"
+
+#if defined (__SSE2__) && (defined (__x86_64__) || defined (__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+using namespace socc;
+
+#ifndef SCAN_X86
+
+static const char *
+scalar_space (const char *p)
+{
+  while (char_is (*p, CHAR_SPACE))
+    p++;
+  return p;
+}
+
+static const char *
+scalar_ident (const char *p)
+{
+  while (char_is (*p, CHAR_IDENT))
+    p++;
+  return p;
+}
+
+static const char *
+scalar_digits (const char *p)
+{
+  while (char_is (*p, CHAR_DIGIT))
+    p++;
+  return p;
+}
+
+static const char *
+scalar_line_end (const char *p, const char *end)
+{
+  while (p < end && *p != '\n')
+    p++;
+  return p;
+}
+
+static const char *
+scalar_string_end (const char *p, const char *end)
+{
+  while (p < end && *p != '"' && *p != '\\' && *p != '\n')
+    p++;
+  return p;
+}
+
+static size_t
+scalar_count_newlines (const char *p, const char *end)
+{
+  size_t count = 0;
+  for (; p < end; p++)
+    count += *p == '\n';
+  return count;
+}
+
+#else
+
+/* Byte classification is done with signed compares, so bytes with the
+   high bit set compare below every ASCII bound and never match. */
+
+static const char *
+sse2_space (const char *p)
+{
+  const __m128i space = _mm_set1_epi8 (' ');
+  const __m128i lo = _mm_set1_epi8 ('\t' - 1);
+  const __m128i hi = _mm_set1_epi8 ('\r' + 1);
+  while (1)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i ws = _mm_or_si128 (_mm_cmpeq_epi8 (v, space),
+				 _mm_and_si128 (_mm_cmpgt_epi8 (v, lo),
+						_mm_cmplt_epi8 (v, hi)));
+      unsigned int mask = ~_mm_movemask_epi8 (ws) & 0xffff;
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += 16;
+    }
+}
+
+static const char *
+sse2_ident (const char *p)
+{
+  const __m128i alpha_lo = _mm_set1_epi8 ('a' - 1);
+  const __m128i alpha_hi = _mm_set1_epi8 ('z' + 1);
+  const __m128i digit_lo = _mm_set1_epi8 ('0' - 1);
+  const __m128i digit_hi = _mm_set1_epi8 ('9' + 1);
+  const __m128i under = _mm_set1_epi8 ('_');
+  const __m128i case_bit = _mm_set1_epi8 (0x20);
+  while (1)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i lower = _mm_or_si128 (v, case_bit);
+      __m128i alpha = _mm_and_si128 (_mm_cmpgt_epi8 (lower, alpha_lo),
+				     _mm_cmplt_epi8 (lower, alpha_hi));
+      __m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (v, digit_lo),
+				     _mm_cmplt_epi8 (v, digit_hi));
+      __m128i ident = _mm_or_si128 (_mm_or_si128 (alpha, digit),
+				    _mm_cmpeq_epi8 (v, under));
+      unsigned int mask = ~_mm_movemask_epi8 (ident) & 0xffff;
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += 16;
+    }
+}
+
+static const char *
+sse2_digits (const char *p)
+{
+  const __m128i lo = _mm_set1_epi8 ('0' - 1);
+  const __m128i hi = _mm_set1_epi8 ('9' + 1);
+  while (1)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (v, lo),
+				     _mm_cmplt_epi8 (v, hi));
+      unsigned int mask = ~_mm_movemask_epi8 (digit) & 0xffff;
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += 16;
+    }
+}
+
+static const char *
+sse2_line_end (const char *p, const char *end)
+{
+  const __m128i nl = _mm_set1_epi8 ('\n');
+  while (p < end)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      unsigned int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, nl));
+      if (mask)
+	{
+	  p += __builtin_ctz (mask);
+	  return p < end ? p : end;
+	}
+      p += 16;
+    }
+  return end;
+}
+
+static const char *
+sse2_string_end (const char *p, const char *end)
+{
+  const __m128i quote = _mm_set1_epi8 ('"');
+  const __m128i bslash = _mm_set1_epi8 ('\\');
+  const __m128i nl = _mm_set1_epi8 ('\n');
+  while (p < end)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i stop = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, quote),
+						 _mm_cmpeq_epi8 (v, bslash)),
+				   _mm_cmpeq_epi8 (v, nl));
+      unsigned int mask = _mm_movemask_epi8 (stop);
+      if (mask)
+	{
+	  p += __builtin_ctz (mask);
+	  return p < end ? p : end;
+	}
+      p += 16;
+    }
+  return end;
+}
+
+static size_t
+sse2_count_newlines (const char *p, const char *end)
+{
+  const __m128i nl = _mm_set1_epi8 ('\n');
+  size_t count = 0;
+  while (p < end)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      unsigned int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, nl));
+      if (end - p < 16)
+	mask &= (1U << (end - p)) - 1;
+      count += __builtin_popcount (mask);
+      p += 16;
+    }
+  return count;
+}
+
+#define AVX2 __attribute__ ((target ("avx2")))
+
+AVX2 static const char *
+avx2_space (const char *p)
+{
+  const __m256i space = _mm256_set1_epi8 (' ');
+  const __m256i lo = _mm256_set1_epi8 ('\t' - 1);
+  const __m256i hi = _mm256_set1_epi8 ('\r' + 1);
+  while (1)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      __m256i ctrl = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, lo),
+				       _mm256_cmpgt_epi8 (hi, v));
+      __m256i ws = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, space), ctrl);
+      unsigned int mask = ~(unsigned int) _mm256_movemask_epi8 (ws);
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += 32;
+    }
+}
+
+AVX2 static const char *
+avx2_ident (const char *p)
+{
+  const __m256i alpha_lo = _mm256_set1_epi8 ('a' - 1);
+  const __m256i alpha_hi = _mm256_set1_epi8 ('z' + 1);
+  const __m256i digit_lo = _mm256_set1_epi8 ('0' - 1);
+  const __m256i digit_hi = _mm256_set1_epi8 ('9' + 1);
+  const __m256i under = _mm256_set1_epi8 ('_');
+  const __m256i case_bit = _mm256_set1_epi8 (0x20);
+  while (1)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      __m256i lower = _mm256_or_si256 (v, case_bit);
+      __m256i alpha =
+	_mm256_and_si256 (_mm256_cmpgt_epi8 (lower, alpha_lo),
+			  _mm256_cmpgt_epi8 (alpha_hi, lower));
+      __m256i digit = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, digit_lo),
+					_mm256_cmpgt_epi8 (digit_hi, v));
+      __m256i ident = _mm256_or_si256 (_mm256_or_si256 (alpha, digit),
+				       _mm256_cmpeq_epi8 (v, under));
+      unsigned int mask = ~(unsigned int) _mm256_movemask_epi8 (ident);
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += 32;
+    }
+}
+
+AVX2 static const char *
+avx2_digits (const char *p)
+{
+  const __m256i lo = _mm256_set1_epi8 ('0' - 1);
+  const __m256i hi = _mm256_set1_epi8 ('9' + 1);
+  while (1)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      __m256i digit = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, lo),
+					_mm256_cmpgt_epi8 (hi, v));
+      unsigned int mask = ~(unsigned int) _mm256_movemask_epi8 (digit);
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += 32;
+    }
+}
+
+AVX2 static const char *
+avx2_line_end (const char *p, const char *end)
+{
+  const __m256i nl = _mm256_set1_epi8 ('\n');
+  while (p < end)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      unsigned int mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, nl));
+      if (mask)
+	{
+	  p += __builtin_ctz (mask);
+	  return p < end ? p : end;
+	}
+      p += 32;
+    }
+  return end;
+}
+
+AVX2 static const char *
+avx2_string_end (const char *p, const char *end)
+{
+  const __m256i quote = _mm256_set1_epi8 ('"');
+  const __m256i bslash = _mm256_set1_epi8 ('\\');
+  const __m256i nl = _mm256_set1_epi8 ('\n');
+  while (p < end)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      __m256i stop =
+	_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, quote),
+					  _mm256_cmpeq_epi8 (v, bslash)),
+			 _mm256_cmpeq_epi8 (v, nl));
+      unsigned int mask = _mm256_movemask_epi8 (stop);
+      if (mask)
+	{
+	  p += __builtin_ctz (mask);
+	  return p < end ? p : end;
+	}
+      p += 32;
+    }
+  return end;
+}
+
+AVX2 static size_t
+avx2_count_newlines (const char *p, const char *end)
+{
+  const __m256i nl = _mm256_set1_epi8 ('\n');
+  size_t count = 0;
+  while (p < end)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      unsigned int mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, nl));
+      if (end - p < 32)
+	mask &= (1U << (end - p)) - 1;
+      count += __builtin_popcount (mask);
+      p += 32;
+    }
+  return count;
+}
+
+#undef AVX2
+
+#endif
+
+/* Integer literals are converted eight digits at a time. Each byte of a
+   64-bit word is classified and turned into its digit value in parallel,
+   then adjacent lanes are merged pairwise, so eight digits take three
+   multiplies instead of eight. Loads may run past the end of the file
+   into the SourceBuffer padding. */
+
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH 0x8080808080808080ULL
+
+static inline uint64_t
+load_le64 (const char *p)
+{
+  uint64_t v;
+  memcpy (&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64 (v);
+#endif
+  return v;
+}
+
+/* Returns a word with the high bit of each byte of V set when that byte
+   is a digit in BASE */
+
+template <unsigned int BASE>
+static inline uint64_t
+swar_digit_mask (uint64_t v)
+{
+  uint64_t x = v & ~SWAR_HIGH;
+  uint64_t ge_zero = x + SWAR_ONES * (0x80 - '0');
+  if (BASE == 16)
+    {
+      uint64_t lower = x | SWAR_ONES * 0x20;
+      uint64_t gt_nine = x + SWAR_ONES * (0x80 - '9' - 1);
+      uint64_t ge_a = lower + SWAR_ONES * (0x80 - 'a');
+      uint64_t gt_f = lower + SWAR_ONES * (0x80 - 'f' - 1);
+      return ((ge_zero & ~gt_nine) | (ge_a & ~gt_f)) & ~v & SWAR_HIGH;
+    }
+  uint64_t too_big = x + SWAR_ONES * (0x80 - '0' - BASE);
+  return ge_zero & ~too_big & ~v & SWAR_HIGH;
+}
+
+template <unsigned int BASE>
+static inline uint64_t
+swar_digit_values (uint64_t v)
+{
+  if (BASE == 16)
+    return (v & SWAR_ONES * 0x0f) + 9 * ((v >> 6) & SWAR_ONES);
+  return v - SWAR_ONES * '0';
+}
+
+template <unsigned int BASE>
+struct DigitScale
+{
+  uint64_t power[9];
+
+  constexpr DigitScale (void) : power {1}
+  {
+    for (int i = 1; i <= 8; i++)
+      power[i] = power[i - 1] * BASE;
+  }
+};
+
+template <unsigned int BASE>
+static const char *
+swar_integer (const char *p, unsigned long long &value, bool &overflow)
+{
+  static constexpr DigitScale <BASE> scale;
+  constexpr uint64_t base2 = BASE * BASE;
+  constexpr uint64_t base4 = base2 * base2;
+
+  value = 0;
+  overflow = false;
+  while (1)
+    {
+      uint64_t v = load_le64 (p);
+      uint64_t invalid = ~swar_digit_mask <BASE> (v) & SWAR_HIGH;
+      unsigned int n = invalid ? __builtin_ctzll (invalid) / 8 : 8;
+      if (n == 0)
+	return p;
+
+      /* Shift out the bytes past the last digit so they act as leading
+	 zeros, then merge lanes of 1, 2 and 4 digits */
+      v = swar_digit_values <BASE> (v) << (8 * (8 - n));
+      v = (v * BASE + (v >> 8)) & 0x00ff00ff00ff00ffULL;
+      v = (v * base2 + (v >> 16)) & 0x0000ffff0000ffffULL;
+      v = (v * base4 + (v >> 32)) & 0x00000000ffffffffULL;
+
+      if (__builtin_mul_overflow (value, scale.power[n], &value)
+	  || __builtin_add_overflow (value, v, &value))
+	overflow = true;
+      p += n;
+      if (n < 8)
+	return p;
+    }
+}
+
+const char *
+socc::scan_integer (const char *p, unsigned int base,
+		    unsigned long long &value, bool &overflow)
+{
+  switch (base)
+    {
+    case 2:
+      return swar_integer <2> (p, value, overflow);
+    case 8:
+      return swar_integer <8> (p, value, overflow);
+    case 16:
+      return swar_integer <16> (p, value, overflow);
+    default:
+      return swar_integer <10> (p, value, overflow);
+    }
+}
+
+#undef SWAR_ONES
+#undef SWAR_HIGH
+
+ScanKernels
+socc::select_scan_kernels (void)
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return {avx2_space, avx2_ident, avx2_digits, avx2_line_end,
+	    avx2_string_end, avx2_count_newlines};
+  return {sse2_space, sse2_ident, sse2_digits, sse2_line_end,
+	  sse2_string_end, sse2_count_newlines};
+#else
+  return {scalar_space, scalar_ident, scalar_digits, scalar_line_end,
+	  scalar_string_end, scalar_count_newlines};
+#endif
+}
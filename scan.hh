@@ -0,0 +1,145 @@
+/* scan.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SCAN_HH
+#define _SCAN_HH
+
+#include <cstddef>
+
+namespace socc
+{
+  /* Character classes used by the lexer. Unlike <cctype> these do not
+     depend on the locale, and bytes outside ASCII belong to no class. */
+  constexpr unsigned char CHAR_IDENT_START = 0x01;
+  constexpr unsigned char CHAR_IDENT = 0x02;
+  constexpr unsigned char CHAR_DIGIT = 0x04;
+  constexpr unsigned char CHAR_HEX_DIGIT = 0x08;
+  constexpr unsigned char CHAR_SPACE = 0x10;
+  constexpr unsigned char CHAR_OPERATOR = 0x20;
+
+  struct CharClassTable
+  {
+    unsigned char classes[256];
+
+    constexpr CharClassTable (void) : classes {}
+    {
+      for (int c = 'a'; c <= 'z'; c++)
+	{
+	  classes[c] |= CHAR_IDENT_START | CHAR_IDENT;
+	  classes[c - 'a' + 'A'] |= CHAR_IDENT_START | CHAR_IDENT;
+	}
+      classes['_'] |= CHAR_IDENT_START | CHAR_IDENT;
+      for (int c = '0'; c <= '9'; c++)
+	classes[c] |= CHAR_IDENT | CHAR_DIGIT | CHAR_HEX_DIGIT;
+      for (int c = 'a'; c <= 'f'; c++)
+	{
+	  classes[c] |= CHAR_HEX_DIGIT;
+	  classes[c - 'a' + 'A'] |= CHAR_HEX_DIGIT;
+	}
+      for (int c = '\t'; c <= '\r'; c++)
+	classes[c] |= CHAR_SPACE;
+      classes[' '] |= CHAR_SPACE;
+      for (const char *p = "!%&()*+,-./;<=>[]^{|}~"; *p; p++)
+	classes[(unsigned char) *p] |= CHAR_OPERATOR;
+    }
+  };
+
+  inline constexpr CharClassTable char_class_table;
+
+  /* Returns whether C belongs to any of the classes in MASK */
+  constexpr bool
+  char_is (char c, unsigned char mask)
+  {
+    return char_class_table.classes[(unsigned char) c] & mask;
+  }
+
+  /* Scanning kernels used by the lexer. The kernels without an end
+     pointer stop at the first byte outside the set they skip, so they
+     rely on the zero padding that follows every SourceBuffer. The best
+     implementation for the running CPU is picked on first use, so code
+     that lexes from a static constructor of a program linking libsocc
+     never sees them unset. */
+  struct ScanKernels
+  {
+    const char *(*space) (const char *p);
+    const char *(*ident) (const char *p);
+    const char *(*digits) (const char *p);
+    const char *(*line_end) (const char *p, const char *end);
+    const char *(*string_end) (const char *p, const char *end);
+    size_t (*count_newlines) (const char *p, const char *end);
+  };
+
+  ScanKernels select_scan_kernels (void);
+
+  inline const ScanKernels &
+  scan_kernels (void)
+  {
+    static const ScanKernels kernels = select_scan_kernels ();
+    return kernels;
+  }
+
+  /* Returns the first byte at or after P that is not whitespace */
+  inline const char *
+  scan_space (const char *p)
+  {
+    return scan_kernels ().space (p);
+  }
+
+  /* Returns the first byte at or after P that is not a letter, digit
+     or underscore */
+  inline const char *
+  scan_ident (const char *p)
+  {
+    return scan_kernels ().ident (p);
+  }
+
+  /* Returns the first byte at or after P that is not a decimal digit */
+  inline const char *
+  scan_digits (const char *p)
+  {
+    return scan_kernels ().digits (p);
+  }
+
+  /* Returns the first newline in [P, END), or END if there is none */
+  inline const char *
+  scan_line_end (const char *p, const char *end)
+  {
+    return scan_kernels ().line_end (p, end);
+  }
+
+  /* Returns the first double quote, backslash or newline in [P, END),
+     or END if there is none */
+  inline const char *
+  scan_string_end (const char *p, const char *end)
+  {
+    return scan_kernels ().string_end (p, end);
+  }
+
+  /* Returns the number of newlines in [P, END) */
+  inline size_t
+  scan_count_newlines (const char *p, const char *end)
+  {
+    return scan_kernels ().count_newlines (p, end);
+  }
+
+  /* Parses the digits of an integer literal in BASE (2, 8, 10 or 16)
+     starting at P into VALUE. Returns the first byte that is not a digit
+     in BASE, and sets OVERFLOW if the value does not fit in 64 bits. */
+  const char *scan_integer (const char *p, unsigned int base,
+			    unsigned long long &value, bool &overflow);
+}
+
+#endif
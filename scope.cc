@@ -0,0 +1,114 @@
+/* scope.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "scope.hh"
+
+using namespace socc;
+
+/* Index of the slot holding NAME, or of the empty slot it would go in */
+
+size_t
+ScopedTable::slot (Symbol name) const
+{
+  size_t mask = slots.size () - 1;
+  size_t i = home (name);
+  while (!slots[i].name.empty () && slots[i].name != name)
+    i = (i + 1) & mask;
+  return i;
+}
+
+/* Empties slot I, moving later entries of its probe sequence back so
+   lookups never stop early at the hole */
+
+void
+ScopedTable::erase (size_t i)
+{
+  size_t mask = slots.size () - 1;
+  size_t j = i;
+  while (1)
+    {
+      j = (j + 1) & mask;
+      if (slots[j].name.empty ())
+	break;
+      size_t k = home (slots[j].name);
+      if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j))
+	{
+	  slots[i] = slots[j];
+	  i = j;
+	}
+    }
+  slots[i].name = Symbol ();
+  count--;
+}
+
+void
+ScopedTable::grow (void)
+{
+  std::vector <Binding> old (slots.size () * 2);
+  old.swap (slots);
+  for (const Binding &binding : old)
+    {
+      if (!binding.name.empty ())
+	slots[slot (binding.name)] = binding;
+    }
+}
+
+void
+ScopedTable::pop_scope (void)
+{
+  size_t mark = marks.back ();
+  marks.pop_back ();
+  while (log.size () > mark)
+    {
+      const Undo &undo = log.back ();
+      size_t i = slot (undo.old.name);
+      if (undo.shadowed)
+	slots[i] = undo.old;
+      else
+	erase (i);
+      log.pop_back ();
+    }
+}
+
+/* Binds NAME in the current scope. A binding made earlier in the same
+   scope is replaced. */
+
+void
+ScopedTable::insert (Symbol name, TypePtr type)
+{
+  size_t i = slot (name);
+  Binding &binding = slots[i];
+  if (binding.name.empty ())
+    {
+      binding = {name, type, depth ()};
+      if (!marks.empty ())
+	log.push_back ({binding, false});
+      if (++count * 2 > slots.size ())
+	grow ();
+      return;
+    }
+  if (binding.depth != depth ())
+    log.push_back ({binding, true});
+  binding.type = type;
+  binding.depth = depth ();
+}
+
+const Binding *
+ScopedTable::find (Symbol name) const
+{
+  const Binding &binding = slots[slot (name)];
+  return binding.name.empty () ? nullptr : &binding;
+}
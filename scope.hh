@@ -0,0 +1,79 @@
+/* scope.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SCOPE_HH
+#define _SCOPE_HH
+
+#include <vector>
+#include "symbol.hh"
+#include "type.hh"
+
+namespace socc
+{
+  /* The declaration a name refers to, and the scope depth it was made
+     at. File scope is depth 0. */
+  struct Binding
+  {
+    Symbol name;
+    TypePtr type;
+    unsigned int depth;
+  };
+
+  /* Bindings visible at the current point of one namespace. Only the
+     innermost binding of each name is kept, in an open-addressing hash
+     table. Shadowed bindings and new names are recorded in an undo log
+     when a binding is added, so leaving a scope restores the enclosing
+     one in time proportional to the declarations made inside it. */
+  class ScopedTable
+  {
+    struct Undo
+    {
+      Binding old;
+      bool shadowed;
+    };
+
+    std::vector <Binding> slots;
+    size_t count;
+    std::vector <Undo> log;
+    std::vector <size_t> marks;
+
+    size_t home (Symbol name) const
+    {
+      return (name.value () * 0x9e3779b97f4a7c15ULL >> 32)
+	& (slots.size () - 1);
+    }
+    size_t slot (Symbol name) const;
+    void erase (size_t i);
+    void grow (void);
+
+  public:
+    ScopedTable (void) : slots (256), count (0) {}
+
+    unsigned int depth (void) const { return marks.size (); }
+    void push_scope (void) { marks.push_back (log.size ()); }
+    void pop_scope (void);
+    void insert (Symbol name, TypePtr type);
+    const Binding *find (Symbol name) const;
+    TypePtr
+    lookup (Symbol name) const
+    {
+      const Binding *binding = find (name);
+      return binding ? binding->type : nullptr;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,139 @@
+/* session.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SESSION_HH
+#define _SESSION_HH
+
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include "arena.hh"
+#include "source.hh"
+#include "symbol.hh"
+#include "type.hh"
+
+namespace socc
+{
+  struct SymbolEntry
+  {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+  };
+
+  /* Open-addressing hash table from spellings to symbol IDs. Spellings
+     are copied into large chunks that are never freed or moved, so the
+     views returned by Symbol::str stay valid as long as the table. */
+  class SymbolTable
+  {
+    static constexpr size_t CHUNK_SIZE = 65536;
+
+    std::vector <std::unique_ptr <char[]>> chunks;
+    char *chunk_ptr;
+    size_t chunk_left;
+    std::vector <uint32_t> slots;
+
+    const char *save (const char *str, size_t len);
+    void grow (void);
+
+  public:
+    std::vector <SymbolEntry> entries;
+
+    SymbolTable (void);
+    uint32_t intern (const char *str, size_t len);
+  };
+
+  /* Set of every type made so far. Children of a type are interned before
+     it, so hashing and comparing a type only looks at its own fields and
+     the pointers to its children. */
+  class TypeTable
+  {
+    struct Hash
+    {
+      size_t operator() (TypePtr type) const;
+    };
+
+    struct Equal
+    {
+      bool operator() (TypePtr a, TypePtr b) const;
+    };
+
+    /* Declarations may be parsed on several threads at once */
+    std::mutex lock;
+    Arena arena;
+    std::unordered_set <TypePtr, Hash, Equal> types;
+
+    TypePtr insert (const Type &proto);
+
+  public:
+    TypeTable (void) : types (1024) {}
+    TypePtr
+    intern (const Type &proto)
+    {
+      std::lock_guard <std::mutex> guard (lock);
+      return insert (proto);
+    }
+    const TypeLayout *save_layout (TypeLayout layout);
+  };
+
+  /* The symbols, types and source files of one compilation. Symbols,
+     types and locations only mean something within the session that made
+     them, and sessions share nothing, so translation units compiled in
+     separate sessions may run on separate threads. A thread works in the
+     session a SessionGuard put it in, or in a global one if there is
+     none. */
+  class Session
+  {
+    static thread_local Session *active;
+
+  public:
+    SymbolTable symbols;
+    TypeTable types;
+    SourceManager sources;
+
+    Session (void) = default;
+    Session (const Session &) = delete;
+    Session &operator= (const Session &) = delete;
+
+    static Session &global (void);
+    static Session &
+    current (void)
+    {
+      return active ? *active : global ();
+    }
+
+    friend class SessionGuard;
+  };
+
+  /* Makes a session current on the calling thread for the lifetime of the
+     guard */
+  class SessionGuard
+  {
+    Session *saved;
+
+  public:
+    explicit SessionGuard (Session &session) : saved (Session::active)
+    {
+      Session::active = &session;
+    }
+    SessionGuard (const SessionGuard &) = delete;
+    ~SessionGuard (void) { Session::active = saved; }
+    SessionGuard &operator= (const SessionGuard &) = delete;
+  };
+}
+
+#endif
@@ -0,0 +1,369 @@
+/* source.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scan.hh"
+#include "source.hh"
+
+using namespace socc;
+
+SourceBuffer::SourceBuffer (SourceBuffer &&other) :
+  base (other.base), len (other.len), alloc_len (other.alloc_len),
+  mapped (other.mapped)
+{
+  other.base = nullptr;
+  other.len = 0;
+  other.alloc_len = 0;
+  other.mapped = false;
+}
+
+SourceBuffer &
+SourceBuffer::operator= (SourceBuffer &&other)
+{
+  if (this != &other)
+    {
+      release ();
+      base = other.base;
+      len = other.len;
+      alloc_len = other.alloc_len;
+      mapped = other.mapped;
+      other.base = nullptr;
+      other.len = 0;
+      other.alloc_len = 0;
+      other.mapped = false;
+    }
+  return *this;
+}
+
+void
+SourceBuffer::release (void)
+{
+  if (mapped)
+    munmap (base, alloc_len);
+  else
+    free (base);
+  base = nullptr;
+  len = 0;
+  alloc_len = 0;
+  mapped = false;
+}
+
+bool
+SourceBuffer::open (const std::string &path)
+{
+  int fd = ::open (path.c_str (), O_RDONLY);
+  if (fd == -1)
+    return false;
+  bool ret = read_fd (fd);
+  int saved_errno = errno;
+  close (fd);
+  errno = saved_errno;
+  return ret;
+}
+
+bool
+SourceBuffer::read_fd (int fd)
+{
+  release ();
+
+  /* Map regular files read from the beginning. An anonymous mapping
+     reserves room for the padding, then the file is mapped over its
+     start so the bytes past the end of the file read as zero. */
+  struct stat st;
+  bool regular = fstat (fd, &st) == 0 && S_ISREG (st.st_mode);
+  if (regular && (uint64_t) st.st_size >= MAX_SIZE)
+    {
+      errno = EFBIG;
+      return false;
+    }
+  if (regular && st.st_size > 0
+      && lseek (fd, 0, SEEK_CUR) == 0)
+    {
+      size_t page = sysconf (_SC_PAGESIZE);
+      size_t size = st.st_size;
+      size_t total = (size + PADDING + page - 1) & ~(page - 1);
+      void *region = mmap (nullptr, total, PROT_READ,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (region != MAP_FAILED)
+	{
+	  if (mmap (region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)
+	      != MAP_FAILED)
+	    {
+	      base = (char *) region;
+	      len = size;
+	      alloc_len = total;
+	      mapped = true;
+	      return true;
+	    }
+	  munmap (region, total);
+	}
+    }
+
+  /* Pipes, terminals and anything that could not be mapped */
+  size_t cap = 65536;
+  base = (char *) malloc (cap + PADDING);
+  if (base == nullptr)
+    return false;
+  while (1)
+    {
+      if (len == cap)
+	{
+	  char *ptr = (char *) realloc (base, cap * 2 + PADDING);
+	  if (ptr == nullptr)
+	    {
+	      release ();
+	      errno = ENOMEM;
+	      return false;
+	    }
+	  base = ptr;
+	  cap *= 2;
+	}
+      ssize_t ret = read (fd, base + len, cap - len);
+      if (ret == 0)
+	break;
+      else if (ret == -1)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  int saved_errno = errno;
+	  release ();
+	  errno = saved_errno;
+	  return false;
+	}
+      len += ret;
+      if (len >= MAX_SIZE)
+	{
+	  release ();
+	  errno = EFBIG;
+	  return false;
+	}
+    }
+  memset (base + len, 0, PADDING);
+  alloc_len = cap + PADDING;
+  return true;
+}
+
+void
+SourceBuffer::read_stream (std::istream &stream)
+{
+  release ();
+  size_t cap = 65536;
+  base = (char *) malloc (cap + PADDING);
+  if (base == nullptr)
+    throw std::bad_alloc ();
+  std::streambuf *buf = stream.rdbuf ();
+  while (1)
+    {
+      if (len == cap)
+	{
+	  char *ptr = (char *) realloc (base, cap * 2 + PADDING);
+	  if (ptr == nullptr)
+	    throw std::bad_alloc ();
+	  base = ptr;
+	  cap *= 2;
+	}
+      std::streamsize ret = buf->sgetn (base + len, cap - len);
+      if (ret <= 0)
+	break;
+      len += ret;
+      if (len >= MAX_SIZE)
+	{
+	  release ();
+	  throw std::length_error ("file too large");
+	}
+    }
+  memset (base + len, 0, PADDING);
+  alloc_len = cap + PADDING;
+}
+
+void
+SourceBuffer::copy (std::string_view text)
+{
+  release ();
+  if (text.size () >= MAX_SIZE)
+    throw std::length_error ("file too large");
+  base = (char *) malloc (text.size () + PADDING);
+  if (base == nullptr)
+    throw std::bad_alloc ();
+  memcpy (base, text.data (), text.size ());
+  memset (base + text.size (), 0, PADDING);
+  len = text.size ();
+  alloc_len = text.size () + PADDING;
+}
+
+SourceManager::FileEntry &
+SourceManager::entry (uint32_t file)
+{
+  std::lock_guard <std::mutex> guard (lock);
+  return *files[file];
+}
+
+uint32_t
+SourceManager::add_entry (std::unique_ptr <FileEntry> file)
+{
+  std::lock_guard <std::mutex> guard (lock);
+  files.push_back (std::move (file));
+  return files.size () - 1;
+}
+
+uint32_t
+SourceManager::add_file (std::string name, SourceBuffer buffer)
+{
+  std::unique_ptr <FileEntry> file = std::make_unique <FileEntry> ();
+  file->name = std::move (name);
+  file->buffer = std::move (buffer);
+  return add_entry (std::move (file));
+}
+
+/* Registers a file known only by its line map, such as the source of a
+   loaded AST. Locations in it resolve as they did in the original. */
+
+uint32_t
+SourceManager::add_file (std::string name, LineMap map)
+{
+  std::unique_ptr <FileEntry> file = std::make_unique <FileEntry> ();
+  file->name = std::move (name);
+  file->text_missing = true;
+  file->size = map.size;
+  file->line_starts = std::move (map.line_starts);
+  file->tabs = std::move (map.tabs);
+  std::call_once (file->line_starts_flag, [] (void) {});
+  return add_entry (std::move (file));
+}
+
+const SourceBuffer &
+SourceManager::buffer (uint32_t file)
+{
+  return entry (file).buffer;
+}
+
+const std::string &
+SourceManager::name (uint32_t file)
+{
+  return entry (file).name;
+}
+
+void
+SourceManager::compute_line_starts (FileEntry &file)
+{
+  const char *data = file.buffer.begin ();
+  size_t size = file.buffer.size ();
+  std::call_once (file.line_starts_flag, [&file, data, size] (void)
+    {
+      file.line_starts.reserve (scan_count_newlines (data, data + size) + 1);
+      file.line_starts.push_back (0);
+      const char *p = data;
+      while ((p = (const char *) memchr (p, '\n', data + size - p)))
+	{
+	  p++;
+	  file.line_starts.push_back (p - data);
+	}
+    });
+}
+
+LineMap
+SourceManager::line_map (uint32_t file)
+{
+  FileEntry &f = entry (file);
+  compute_line_starts (f);
+  LineMap map;
+  map.line_starts = f.line_starts;
+  if (f.text_missing)
+    {
+      map.size = f.size;
+      map.tabs = f.tabs;
+      return map;
+    }
+  const char *data = f.buffer.begin ();
+  map.size = f.buffer.size ();
+  const char *p = data;
+  while ((p = (const char *) memchr (p, '\t', data + map.size - p)))
+    map.tabs.push_back (p++ - data);
+  return map;
+}
+
+/* A location names the character at its offset, and its line and column
+   are those in effect after reading that character. A newline therefore
+   reports column 0 of the following line. Tabs advance the column the
+   same way the lexer always has. Columns are counted from the start of
+   the line, or from the last location presumed if it is earlier on the
+   same line, so formatting every token of a long line stays linear. */
+
+static inline unsigned long
+tab_column (unsigned long col)
+{
+  return ((col - 2) | 7) + 2;
+}
+
+PresumedLocation
+SourceManager::presumed (Location loc)
+{
+  FileEntry &file = entry (loc.file);
+  compute_line_starts (file);
+  const char *data = file.buffer.begin ();
+  size_t size = file.text_missing ? file.size : file.buffer.size ();
+  if (size == 0)
+    return {file.name, 1, 0};
+
+  uint32_t offset = loc.offset < size ? loc.offset : size - 1;
+  auto it = std::upper_bound (file.line_starts.begin (),
+			      file.line_starts.end (), offset);
+  unsigned long line = it - file.line_starts.begin ();
+  unsigned long col = 0;
+  if (file.text_missing)
+    {
+      if (it != file.line_starts.end () && *it == offset + 1)
+	return {file.name, line + 1, 0};
+      uint32_t pos = it[-1];
+      for (auto tab = std::lower_bound (file.tabs.begin (), file.tabs.end (),
+					pos);
+	   tab != file.tabs.end () && *tab <= offset; tab++)
+	{
+	  col = tab_column (col + *tab - pos);
+	  pos = *tab + 1;
+	}
+      return {file.name, line, col + offset + 1 - pos};
+    }
+  if (data[offset] == '\n')
+    return {file.name, line + 1, 0};
+  std::lock_guard <std::mutex> guard (file.column_lock);
+  const char *p = data + it[-1];
+  if (file.column_line == it[-1] && file.column_offset <= offset)
+    {
+      p = data + file.column_offset + 1;
+      col = file.column;
+    }
+  for (; p <= data + offset; p++)
+    {
+      if (*p == '\t')
+	col = tab_column (col);
+      else
+	col++;
+    }
+  file.column_line = it[-1];
+  file.column_offset = offset;
+  file.column = col;
+  return {file.name, line, col};
+}
@@ -0,0 +1,124 @@
+/* source.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SOURCE_HH
+#define _SOURCE_HH
+
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "location.hh"
+
+namespace socc
+{
+  /* Contiguous, read-only copy of a translation unit. Regular files are
+     mapped into memory, anything else is read into a single heap buffer.
+     At least PADDING zero bytes are readable past the end of the data so
+     the lexer may look ahead without bounds checks. Locations hold 32-bit
+     offsets, so inputs of MAX_SIZE bytes or more are refused. */
+  class SourceBuffer
+  {
+    char *base;
+    size_t len;
+    size_t alloc_len;
+    bool mapped;
+
+    void release (void);
+
+  public:
+    static constexpr size_t PADDING = 64;
+    static constexpr size_t MAX_SIZE = UINT32_MAX;
+
+    SourceBuffer (void) :
+      base (nullptr), len (0), alloc_len (0), mapped (false) {}
+    SourceBuffer (const SourceBuffer &) = delete;
+    SourceBuffer (SourceBuffer &&other);
+    ~SourceBuffer (void) { release (); }
+    SourceBuffer &operator= (const SourceBuffer &) = delete;
+    SourceBuffer &operator= (SourceBuffer &&other);
+
+    bool open (const std::string &path);
+    bool read_fd (int fd);
+    void read_stream (std::istream &stream);
+    void copy (std::string_view text);
+    const char *begin (void) const { return base; }
+    const char *end (void) const { return base + len; }
+    size_t size (void) const { return len; }
+  };
+
+  /* Line and column of a location, as reported in diagnostics */
+  struct PresumedLocation
+  {
+    const std::string &name;
+    unsigned long line;
+    unsigned long col;
+  };
+
+  /* What presumed needs to know about a file whose text is not at hand:
+     its size, where its lines start and where it has tabs */
+  struct LineMap
+  {
+    uint32_t size = 0;
+    std::vector <uint32_t> line_starts;
+    std::vector <uint32_t> tabs;
+  };
+
+  /* Table of every file read in a session. Locations refer to files by
+     their index in this table, and files are kept as long as the session
+     so those references never dangle. */
+  class SourceManager
+  {
+    struct FileEntry
+    {
+      std::string name;
+      SourceBuffer buffer;
+      std::vector <uint32_t> line_starts;
+      std::once_flag line_starts_flag;
+
+      /* Column of the last location presumed in this file, so queries
+	 moving forward along one line resume from it */
+      std::mutex column_lock;
+      uint32_t column_line = UINT32_MAX;
+      uint32_t column_offset = 0;
+      unsigned long column = 0;
+
+      /* Only set for files added from a line map */
+      bool text_missing = false;
+      uint32_t size = 0;
+      std::vector <uint32_t> tabs;
+    };
+
+    std::vector <std::unique_ptr <FileEntry>> files;
+    std::mutex lock;
+
+    FileEntry &entry (uint32_t file);
+    uint32_t add_entry (std::unique_ptr <FileEntry> file);
+    static void compute_line_starts (FileEntry &file);
+
+  public:
+    uint32_t add_file (std::string name, SourceBuffer buffer);
+    uint32_t add_file (std::string name, LineMap map);
+    const std::string &name (uint32_t file);
+    LineMap line_map (uint32_t file);
+    const SourceBuffer &buffer (uint32_t file);
+    PresumedLocation presumed (Location loc);
+  };
+}
+
+#endif
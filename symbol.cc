@@ -0,0 +1,128 @@
+/* symbol.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <cstring>
+#include "session.hh"
+
+using namespace socc;
+
+static uint32_t
+hash_bytes (const char *str, size_t len)
+{
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  uint64_t w;
+  while (len >= 8)
+    {
+      memcpy (&w, str, 8);
+      h = (h ^ w) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+      str += 8;
+      len -= 8;
+    }
+  if (len)
+    {
+      w = 0;
+      memcpy (&w, str, len);
+      h = (h ^ w) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+    }
+  return h ^ (h >> 29);
+}
+
+SymbolTable::SymbolTable (void) : chunk_ptr (nullptr), chunk_left (0)
+{
+  entries.push_back ({"", 0, 0});
+  slots.resize (4096);
+}
+
+const char *
+SymbolTable::save (const char *str, size_t len)
+{
+  if (len + 1 > chunk_left)
+    {
+      size_t size = len + 1 > CHUNK_SIZE ? len + 1 : CHUNK_SIZE;
+      chunks.emplace_back (new char[size]);
+      chunk_ptr = chunks.back ().get ();
+      chunk_left = size;
+    }
+  char *ptr = chunk_ptr;
+  memcpy (ptr, str, len);
+  ptr[len] = '\0';
+  chunk_ptr += len + 1;
+  chunk_left -= len + 1;
+  return ptr;
+}
+
+void
+SymbolTable::grow (void)
+{
+  std::vector <uint32_t> old (slots.size () * 2);
+  old.swap (slots);
+  size_t mask = slots.size () - 1;
+  for (uint32_t id : old)
+    {
+      if (id == 0)
+	continue;
+      size_t i = entries[id].hash & mask;
+      while (slots[i])
+	i = (i + 1) & mask;
+      slots[i] = id;
+    }
+}
+
+uint32_t
+SymbolTable::intern (const char *str, size_t len)
+{
+  if (len == 0)
+    return 0;
+  uint32_t hash = hash_bytes (str, len);
+  size_t mask = slots.size () - 1;
+  size_t i = hash & mask;
+  while (slots[i])
+    {
+      const SymbolEntry &entry = entries[slots[i]];
+      if (entry.hash == hash && entry.len == len
+	  && memcmp (entry.str, str, len) == 0)
+	return slots[i];
+      i = (i + 1) & mask;
+    }
+
+  uint32_t id = entries.size ();
+  entries.push_back ({save (str, len), (uint32_t) len, hash});
+  slots[i] = id;
+  if (entries.size () * 2 > slots.size ())
+    grow ();
+  return id;
+}
+
+Symbol
+Symbol::intern (const char *str, size_t len)
+{
+  return Symbol (Session::current ().symbols.intern (str, len));
+}
+
+std::string_view
+Symbol::str (void) const
+{
+  const SymbolEntry &entry = Session::current ().symbols.entries[id];
+  return std::string_view (entry.str, entry.len);
+}
+
+std::ostream &
+operator<< (std::ostream &os, socc::Symbol sym)
+{
+  return os << sym.str ();
+}
@@ -0,0 +1,70 @@
+/* symbol.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SYMBOL_HH
+#define _SYMBOL_HH
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string_view>
+
+namespace socc
+{
+  /* An interned identifier. Every spelling is stored once in the table
+     of the current session and referred to by a 32-bit ID, so two symbols
+     of a session are equal exactly when their IDs are. ID 0 is the empty
+     string. */
+  class Symbol
+  {
+    uint32_t id;
+
+  public:
+    Symbol (void) : id (0) {}
+    explicit Symbol (uint32_t id) : id (id) {}
+
+    static Symbol intern (const char *str, size_t len);
+    static Symbol intern (std::string_view str)
+    {
+      return intern (str.data (), str.size ());
+    }
+
+    uint32_t value (void) const { return id; }
+    bool empty (void) const { return id == 0; }
+    std::string_view str (void) const;
+
+    bool operator== (Symbol other) const { return id == other.id; }
+    bool operator!= (Symbol other) const { return id != other.id; }
+    bool operator< (Symbol other) const { return id < other.id; }
+  };
+}
+
+namespace std
+{
+  template <>
+  struct hash <socc::Symbol>
+  {
+    size_t
+    operator() (socc::Symbol sym) const
+    {
+      return sym.value ();
+    }
+  };
+}
+
+std::ostream &operator<< (std::ostream &os, socc::Symbol sym);
+
+#endif
@@ -0,0 +1,75 @@
+#!/bin/sh
+# Usage: ast-round-trip.sh SOCC INPUT
+# Writes the AST of INPUT with --emit-ast, reads it back with --load-ast
+# and compares the result with what --flat-ast prints for INPUT. Then
+# checks that truncated files, files with a bad magic number, files
+# from another version of the format and files with out-of-range indices
+# are rejected.
+
+socc=$1
+input=$2
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+"$socc" --flat-ast "$input" > "$tmp/expected" || exit 1
+"$socc" --emit-ast "$tmp/good.ast" "$input" || exit 1
+"$socc" --load-ast "$tmp/good.ast" > "$tmp/out" || exit 1
+diff -u "$tmp/expected" "$tmp/out" || exit 1
+
+# Expects socc to fail to load the file NAME with the error MESSAGE
+reject ()
+{
+  "$socc" --load-ast "$tmp/$1" > /dev/null 2> "$tmp/err"
+  code=$?
+  if [ $code -ne 1 ]; then
+    echo "$1: socc exited with status $code" >&2
+    return 1
+  fi
+  echo "fatal error: failed to load $tmp/$1: $2" | diff -u - "$tmp/err"
+}
+
+# Overwrites the byte at OFFSET of the file NAME with OCTAL
+patch_byte ()
+{
+  printf "\\$3" | dd of="$tmp/$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# Prints field FIELD (0 for the offset, 1 for the size) of section
+# SECTION from the header of the good file
+section_field ()
+{
+  od -An -tu8 -j $((32 + $1 * 16 + $2 * 8)) -N8 "$tmp/good.ast" | tr -d ' '
+}
+
+size=$(wc -c < "$tmp/good.ast")
+status=0
+
+head -c 20 "$tmp/good.ast" > "$tmp/short-header.ast"
+reject short-header.ast "file is truncated" || status=1
+
+head -c $((size - 1)) "$tmp/good.ast" > "$tmp/short-body.ast"
+reject short-body.ast "file is truncated" || status=1
+
+cp "$tmp/good.ast" "$tmp/magic.ast"
+patch_byte magic.ast 0 130
+reject magic.ast "not an AST file" || status=1
+
+cp "$tmp/good.ast" "$tmp/version.ast"
+patch_byte version.ast 8 377
+reject version.ast "AST file was written by an incompatible compiler" \
+  || status=1
+
+# Makes the first root, and then the last extra operand, point far past
+# the end of the file
+roots=$(section_field 2 0)
+cp "$tmp/good.ast" "$tmp/root.ast"
+patch_byte root.ast $((roots + 3)) 177
+reject root.ast "AST file is corrupt" || status=1
+
+extra_end=$(($(section_field 1 0) + $(section_field 1 1)))
+cp "$tmp/good.ast" "$tmp/extra.ast"
+patch_byte extra.ast $((extra_end - 1)) 177
+reject extra.ast "AST file is corrupt" || status=1
+
+exit $status
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Usage: check-output.sh SOCC INPUT EXPECTED [OPTION...]
+# Compiles INPUT, read from standard input, with the given options and
+# compares what socc writes to standard output, followed by what it
+# writes to standard error, with the file EXPECTED.
+
+socc=$1
+input=$2
+expected=$3
+shift 3
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+"$socc" "$@" < "$input" > "$tmp/out" 2> "$tmp/err"
+status=$?
+if [ $status -gt 1 ]; then
+  echo "socc exited with status $status" >&2
+  exit 1
+fi
+cat "$tmp/out" "$tmp/err" | diff -u "$expected" -
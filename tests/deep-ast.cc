@@ -0,0 +1,98 @@
+/* deep-ast.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Checks that an AST file with blocks nested far deeper than the parser
+   allows can be loaded and printed */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "flat-ast.hh"
+#include "session.hh"
+
+using namespace socc;
+
+static constexpr uint32_t DEPTH = 1000000;
+
+int
+main (void)
+{
+  Session session;
+  SessionGuard guard (session);
+
+  SourceBuffer buffer;
+  buffer.copy ("int\nf (void)\n{\n}\n");
+  FlatAST ast;
+  ast.file = session.sources.add_file ("deep.c", std::move (buffer));
+  ast.types.push_back (Type::get_primitive (PrimitiveType::Int, false));
+
+  /* int f (void) { { { ... } } }, with each block the only statement of
+     the one around it */
+  ast.extra.push_back (0);
+  ast.nodes.push_back ({NodeKind::Block, 0, 0, 0, 0, 0});
+  for (uint32_t i = 1; i <= DEPTH; i++)
+    {
+      uint32_t list = ast.extra.size ();
+      ast.extra.push_back (1);
+      ast.extra.push_back (i - 1);
+      ast.nodes.push_back ({NodeKind::Block, 0, 0, 0, 0, list});
+    }
+  uint32_t decl = ast.extra.size ();
+  ast.extra.push_back (Symbol::intern ("f").value ());
+  ast.extra.push_back (DEPTH);
+  ast.extra.push_back (0);
+  ast.roots.push_back (ast.nodes.size ());
+  ast.nodes.push_back ({NodeKind::FuncDefinition, 0, 0, 0, 0, decl});
+
+  char path[] = "/tmp/socc-deep-XXXXXX";
+  int fd = mkstemp (path);
+  if (fd == -1)
+    {
+      std::cerr << "failed to create " << path << std::endl;
+      return 1;
+    }
+  close (fd);
+  bool saved = ast.save (path);
+  FlatAST loaded;
+  std::string error;
+  bool ok = saved && loaded.load (path, error);
+  unlink (path);
+  if (!ok)
+    {
+      std::cerr << "failed to round-trip the AST: "
+		<< (saved ? error : "save failed") << std::endl;
+      return 1;
+    }
+
+  std::string out;
+  {
+    Writer os (out);
+    loaded.print (os, loaded.roots[0]);
+  }
+  std::string expected = "int\nf (void)\n";
+  for (uint32_t i = 0; i < DEPTH; i++)
+    expected += "{\n  ";
+  expected += "{\n}";
+  for (uint32_t i = 0; i < DEPTH; i++)
+    expected += "\n}";
+  if (out != expected)
+    {
+      std::cerr << "nested blocks printed wrongly" << std::endl;
+      return 1;
+    }
+  return 0;
+}
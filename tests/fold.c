@@ -0,0 +1,61 @@
+int x;
+int *p;
+int
+f (void)
+{
+  x = 2147483647 + 1;
+  x = 2147483647U + 1;
+  x = 1 + 2L;
+  x = 1U + 2LL;
+  x = 4294967295U + 1LL;
+  x = -1 < 1U;
+  x = -1LL < 1U;
+  x = -1 < 1ULL;
+  x = -2147483647 - 2;
+  x = -(-2147483647 - 1);
+  x = -0U;
+  x = 9223372036854775807LL * 2;
+  x = 1 / 0;
+  x = 1 % 0;
+  x = -7 / 2;
+  x = -7 % 2;
+  x = (-2147483647 - 1) / -1;
+  x = 1 << 32;
+  x = 1 << -1;
+  x = 1LL << 40;
+  x = 1 << 31;
+  x = ~0U >> 31;
+  x = -8 >> 1;
+  x = (x + 1) + 0;
+  x = (x + 1) - 0;
+  x = (x + 1) << 0;
+  x = (x + 1) >> 0;
+  x = (x + 1) | 0;
+  x = (x + 1) ^ 0;
+  x = (x + 1) * 1;
+  x = (x + 1) / 1;
+  x = 0 + (x + 1);
+  x = 0 ^ (x + 1);
+  x = 0 | (x + 1);
+  x = 1 * (x + 1);
+  x = x * 0;
+  x = 0 & x;
+  x = x++ * 0;
+  x = 0 & x++;
+  x = 0 && x++;
+  x = 1 || x++;
+  x = !!(x < 1);
+  x = !!x;
+  x + 0 = 5;
+  x - 0 = 5;
+  0 + x = 5;
+  (x * 1)++;
+  1 * x = 5;
+  x / 1 = 5;
+  x << 0 = 5;
+  x | 0 = 5;
+  x ^ 0 = 5;
+  p[0] * 1 = 5;
+  *p + 0 = 5;
+  !!x = 5;
+}
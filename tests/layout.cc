@@ -0,0 +1,151 @@
+/* layout.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Checks the sizes, alignments and member offsets computed by
+   Type::layout */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "session.hh"
+
+using namespace socc;
+
+static int failures;
+
+static void
+check (const char *what, size_t got, size_t expected)
+{
+  if (got == expected)
+    return;
+  std::cerr << what << ": got " << got << ", expected " << expected
+	    << std::endl;
+  failures++;
+}
+
+static void
+check_layout (const char *what, TypePtr type, size_t size, size_t align,
+	      std::vector <size_t> offsets = {})
+{
+  const TypeLayout *layout = type->layout ();
+  if (!layout)
+    {
+      std::cerr << what << ": no layout" << std::endl;
+      failures++;
+      return;
+    }
+  std::string name (what);
+  check ((name + " size").c_str (), layout->size, size);
+  check ((name + " align").c_str (), layout->align, align);
+  check ((name + " member count").c_str (), layout->offsets.size (),
+	 offsets.size ());
+  for (size_t i = 0; i < offsets.size () && i < layout->offsets.size (); i++)
+    check ((name + " offset " + std::to_string (i)).c_str (),
+	   layout->offsets[i], offsets[i]);
+}
+
+static void
+check_incomplete (const char *what, TypePtr type)
+{
+  if (type->layout ())
+    {
+      std::cerr << what << ": incomplete type has a layout" << std::endl;
+      failures++;
+    }
+  check (what, type->width (), 0);
+}
+
+int
+main (void)
+{
+  Session session;
+  SessionGuard guard (session);
+  constexpr bool lp64 = LP_WIDTH == 8;
+
+  TypePtr c = Type::get_primitive (PrimitiveType::Char, false);
+  TypePtr s = Type::get_primitive (PrimitiveType::Short, false);
+  TypePtr i = Type::get_primitive (PrimitiveType::Int, false);
+  TypePtr l = Type::get_primitive (PrimitiveType::Long, false);
+  TypePtr d = Type::get_primitive (PrimitiveType::Double, false);
+  TypePtr ld = Type::get_primitive (PrimitiveType::LongDouble, false);
+  TypePtr v = Type::get_primitive (PrimitiveType::Void, false);
+  TypePtr ip = Type::get_pointer (i);
+
+  check_layout ("char", c, 1, 1);
+  check_layout ("long", l, LP_WIDTH, LP_WIDTH);
+  check_layout ("double", d, 8, lp64 ? 8 : 4);
+  check_layout ("long double", ld, 16, lp64 ? 16 : 4);
+  check_layout ("int *", ip, LP_WIDTH, LP_WIDTH);
+  check_layout ("const int", i->qualified (true, false), 4, 4);
+  if (i->qualified (true, false)->layout () != i->layout ())
+    {
+      std::cerr << "const int: layout not shared" << std::endl;
+      failures++;
+    }
+
+  /* struct { char; int; short; } pads after the char and at the end */
+  TypePtr small = Type::get_struct ({c, i, s});
+  check_layout ("small", small, 12, 4, {0, 4, 8});
+
+  /* struct t { char; double; small; char[3]; int *; } */
+  TypePtr chars = Type::get_array (c, 3);
+  check_layout ("char[3]", chars, 3, 1);
+  TypePtr nested = Type::get_struct (Symbol::intern ("t"),
+				     {c, d, small, chars, ip});
+  if (lp64)
+    check_layout ("nested", nested, 40, 8, {0, 8, 16, 28, 32});
+  else
+    check_layout ("nested", nested, 32, 4, {0, 4, 12, 24, 28});
+
+  check_layout ("small[5]", Type::get_array (small, 5), 60, 4);
+  check_layout ("nested[2][3]",
+		Type::get_array (Type::get_array (nested, 3), 2),
+		lp64 ? 240 : 192, lp64 ? 8 : 4);
+  check_layout ("struct { long double; char; }",
+		Type::get_struct ({ld, c}), lp64 ? 32 : 20, lp64 ? 16 : 4,
+		{0, 16});
+
+  TypePtr fwd = Type::get_struct (Symbol::intern ("u"));
+  check_incomplete ("void", v);
+  check_incomplete ("struct u", fwd);
+  check_incomplete ("struct u[4]", Type::get_array (fwd, 4));
+  check_incomplete ("struct { int; struct u; }",
+		    Type::get_struct ({i, fwd}));
+  check_layout ("struct u *", Type::get_pointer (fwd), LP_WIDTH, LP_WIDTH);
+
+  /* A type keeps its layout and variants in the session that made it,
+     even if another session is current when they are first asked for */
+  TypePtr pair = Type::get_struct ({l, c});
+  const TypeLayout *pair_layout;
+  TypePtr const_pair;
+  {
+    Session other;
+    SessionGuard use_other (other);
+    pair_layout = pair->layout ();
+    const_pair = pair->qualified (true, false);
+  }
+  check_layout ("struct { long; char; }", pair, lp64 ? 16 : 8, LP_WIDTH,
+		{0, LP_WIDTH});
+  if (pair->layout () != pair_layout || const_pair->unqualified () != pair)
+    {
+      std::cerr << "struct { long; char; }: made in another session"
+		<< std::endl;
+      failures++;
+    }
+
+  return failures ? 1 : 0;
+}
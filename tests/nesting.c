@@ -0,0 +1,13 @@
+int x = ((((1)))) + 1;
+int y = (((((1))))) * 2;
+int
+f (int a)
+{
+  a = (((((a))))) & a;
+  return a[((((((1))))))];
+  return g ((((((a))))), a);
+  return -(((((a)))));
+  a = 1 + (((((a)))));
+  return a;
+}
+int z = 3;
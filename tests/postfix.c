@@ -0,0 +1,9 @@
+int f (void)
+{
+  return -p++->n;
+  ++90U++.m;
+  --"zz"--->n;
+  x = p++->n;
+  return a--[2] (3)++;
+  return *p--.q[1]++;
+}
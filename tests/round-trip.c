@@ -0,0 +1,47 @@
+static const unsigned long limit = 40;
+extern volatile char *name;
+int counter;
+int scale (int value, unsigned int factor);
+
+int
+sum (int *values, unsigned int count)
+{
+  int total = 0;
+  unsigned int i = count;
+  total += values[i - 1] * 2;
+  total = total << 3 | ~total & 0x1f;
+  return total % 7;
+}
+
+static long
+classify (long c, long n)
+{
+  register int kind = c == 10 || c > 2;
+  n -= 100L;
+  {
+    long shifted = n >> 2;
+    kind = !shifted && kind != 3;
+  }
+  kind = -kind + +n;
+  return kind <= 10;
+}
+
+int
+greet (char *who)
+{
+  char *p = who;
+  *p++ = 104;
+  p[0] = who[1];
+  p->x = &counter;
+  p->y.z = counter--;
+  greet ("hello, world\t\"quoted\"");
+  return;
+}
+
+int
+main (void)
+{
+  int value = scale (counter++, --counter);
+  value = sum (&value, 1) - classify (42L, limit) + value / 3;
+  return value >= 0 ^ value < 4;
+}
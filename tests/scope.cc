@@ -0,0 +1,210 @@
+/* scope.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Checks shadowing and scope exit in ScopedTable, including the removal
+   of names from probe sequences that wrap around the end of the table
+   after it has grown */
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "scope.hh"
+#include "session.hh"
+
+using namespace socc;
+
+static int failures;
+
+static void
+check_binding (const ScopedTable &table, const char *what, Symbol name,
+	       TypePtr type, unsigned int depth)
+{
+  const Binding *binding = table.find (name);
+  if (!binding)
+    {
+      std::cerr << what << ": " << name << " not found" << std::endl;
+      failures++;
+      return;
+    }
+  if (binding->name != name || binding->type != type
+      || binding->depth != depth)
+    {
+      std::cerr << what << ": wrong binding for " << name << std::endl;
+      failures++;
+    }
+}
+
+static void
+check_unbound (const ScopedTable &table, const char *what, Symbol name)
+{
+  if (table.find (name))
+    {
+      std::cerr << what << ": " << name << " still bound" << std::endl;
+      failures++;
+    }
+}
+
+/* Home slot of NAME in a table of SIZE slots, as ScopedTable::home
+   computes it */
+static size_t
+home (Symbol name, size_t size)
+{
+  return (name.value () * 0x9e3779b97f4a7c15ULL >> 32) & (size - 1);
+}
+
+/* Returns COUNT new symbols whose home slot in a table of SIZE slots is
+   SLOT */
+static std::vector <Symbol>
+names_at (size_t slot, size_t size, size_t count)
+{
+  static unsigned long next;
+  std::vector <Symbol> names;
+  while (names.size () < count)
+    {
+      Symbol name = Symbol::intern ("n" + std::to_string (next++));
+      if (home (name, size) == slot)
+	names.push_back (name);
+    }
+  return names;
+}
+
+int
+main (void)
+{
+  Session session;
+  SessionGuard guard (session);
+
+  TypePtr c = Type::get_primitive (PrimitiveType::Char, false);
+  TypePtr i = Type::get_primitive (PrimitiveType::Int, false);
+  TypePtr l = Type::get_primitive (PrimitiveType::Long, false);
+  TypePtr ip = Type::get_pointer (i);
+  Symbol x = Symbol::intern ("x");
+  Symbol y = Symbol::intern ("y");
+  Symbol z = Symbol::intern ("z");
+
+  /* Shadowing, redeclaration in the same scope and scope exit */
+  ScopedTable table;
+  table.insert (x, i);
+  table.insert (y, c);
+  check_binding (table, "file scope", x, i, 0);
+  check_unbound (table, "file scope", z);
+  table.push_scope ();
+  table.insert (x, l);
+  table.insert (z, c);
+  check_binding (table, "shadowed", x, l, 1);
+  check_binding (table, "not shadowed", y, c, 0);
+  table.push_scope ();
+  table.insert (x, ip);
+  table.insert (x, c);
+  table.insert (y, ip);
+  check_binding (table, "redeclared", x, c, 2);
+  check_binding (table, "shadowed twice", y, ip, 2);
+  table.pop_scope ();
+  check_binding (table, "after inner scope", x, l, 1);
+  check_binding (table, "after inner scope", y, c, 0);
+  check_binding (table, "after inner scope", z, c, 1);
+  table.pop_scope ();
+  check_binding (table, "after outer scope", x, i, 0);
+  check_binding (table, "after outer scope", y, c, 0);
+  check_unbound (table, "after outer scope", z);
+  if (table.depth () != 0)
+    {
+      std::cerr << "depth not restored" << std::endl;
+      failures++;
+    }
+
+  /* Names declared in a scope that makes the table grow from 256 to 512
+     slots. Rehashing puts the inner names whose home is the last slot
+     first, so one of the file-scope names, whose home is the slot
+     before, is pushed past the end of the table to the start. Leaving
+     the scope has to move it back over the hole the last slot leaves. */
+  ScopedTable wrap;
+  std::vector <Symbol> outer = names_at (510, 512, 3);
+  for (Symbol name : outer)
+    wrap.insert (name, i);
+  wrap.push_scope ();
+  std::vector <Symbol> inner = names_at (511, 512, 8);
+  std::vector <Symbol> more = names_at (0, 512, 8);
+  inner.insert (inner.end (), more.begin (), more.end ());
+  more = names_at (1, 512, 4);
+  inner.insert (inner.end (), more.begin (), more.end ());
+  for (Symbol name : inner)
+    wrap.insert (name, c);
+  wrap.insert (outer[1], l);
+  for (unsigned long n = 0; n < 200; n++)
+    wrap.insert (Symbol::intern ("f" + std::to_string (n)), l);
+  for (Symbol name : inner)
+    check_binding (wrap, "grown", name, c, 1);
+  check_binding (wrap, "grown", outer[1], l, 1);
+  wrap.pop_scope ();
+  for (Symbol name : outer)
+    check_binding (wrap, "wrapped", name, i, 0);
+  for (Symbol name : inner)
+    check_unbound (wrap, "wrapped", name);
+  for (unsigned long n = 0; n < 200; n++)
+    check_unbound (wrap, "wrapped",
+		   Symbol::intern ("f" + std::to_string (n)));
+
+  /* Many nested scopes, checked against a map of binding stacks */
+  ScopedTable deep;
+  std::map <Symbol, std::vector <Binding>> model;
+  std::vector <std::vector <Symbol>> declared (1);
+  TypePtr types[] = {c, i, l, ip};
+  uint64_t step = 0;
+  for (int round = 0; round < 4; round++)
+    {
+      for (unsigned int d = 1; d <= 40; d++)
+	{
+	  deep.push_scope ();
+	  declared.emplace_back ();
+	  for (int k = 0; k < 12; k++)
+	    {
+	      step = step * 6364136223846793005ULL + 1442695040888963407ULL;
+	      Symbol name = Symbol::intern ("v" + std::to_string (step >> 54));
+	      TypePtr type = types[step >> 62];
+	      std::vector <Binding> &stack = model[name];
+	      if (!stack.empty () && stack.back ().depth == d)
+		stack.back ().type = type;
+	      else
+		{
+		  stack.push_back ({name, type, d});
+		  declared.back ().push_back (name);
+		}
+	      deep.insert (name, type);
+	    }
+	}
+      for (unsigned int d = 40; d > 0; d--)
+	{
+	  deep.pop_scope ();
+	  for (Symbol name : declared.back ())
+	    model[name].pop_back ();
+	  declared.pop_back ();
+	  for (const auto &entry : model)
+	    {
+	      if (entry.second.empty ())
+		check_unbound (deep, "nested", entry.first);
+	      else
+		check_binding (deep, "nested", entry.first,
+			       entry.second.back ().type,
+			       entry.second.back ().depth);
+	    }
+	}
+    }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+# Usage: stress.py SOCC N [OPTION...]
+# Runs socc with the given options on sources that chain or nest
+# expressions and statements N deep. Each must be compiled or diagnosed;
+# the test fails if socc crashes on any of them.
+
+import subprocess
+import sys
+
+SHAPES = {
+    'add': lambda n: 'int main (int a)\n{\n  return a'
+                     + ' + a' * n + ';\n}\n',
+    'assign': lambda n: 'int main (int a)\n{\n  ' + 'a = ' * n
+                        + 'a;\n  return a;\n}\n',
+    'call': lambda n: 'int main (int f)\n{\n  return f' + '()' * n
+                      + ';\n}\n',
+    'member': lambda n: 'int main (int a)\n{\n  return a' + '.b' * n
+                        + ';\n}\n',
+    'not': lambda n: 'int main (int a)\n{\n  return ' + '!' * n
+                     + 'a;\n}\n',
+    'unary': lambda n: 'int x = ' + '-' * n + '1;\n',
+    'parens': lambda n: 'int x = ' + '(' * n + '1' + ')' * n
+                        + ';\nint y = 2;\n',
+    'blocks': lambda n: 'int main (void)\n{\n' + '{' * n + '}' * n
+                        + '\n  return 0;\n}\n',
+    'baddecl': lambda n: 'int main (void)\n{\n' + '  int 1;\n' * n + '}\n',
+    'mulzero': lambda n: 'int main (int a)\n{\n  return (a' + ' + a' * n
+                         + ') * 0;\n}\n'
+}
+
+def main ():
+    socc = sys.argv[1]
+    n = int (sys.argv[2])
+    options = sys.argv[3:]
+    failed = False
+    for name, shape in SHAPES.items ():
+        proc = subprocess.run ([socc] + options, input=shape (n).encode (),
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL)
+        if proc.returncode not in (0, 1):
+            print ('%s-%d: socc exited with status %d'
+                   % (name, n, proc.returncode))
+            failed = True
+    return 1 if failed else 0
+
+if __name__ == '__main__':
+    sys.exit (main ())
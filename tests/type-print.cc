@@ -0,0 +1,69 @@
+/* type-print.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Checks the spellings written by Type::print. Function types cannot be
+   written in the accepted grammar yet, so they are built directly. */
+
+#include <iostream>
+#include <string>
+#include "session.hh"
+#include "writer.hh"
+
+using namespace socc;
+
+static int failures;
+
+static void
+check_print (TypePtr type, const std::string &expected)
+{
+  std::string text;
+  {
+    Writer os (text);
+    type->print (os);
+  }
+  if (text != expected)
+    {
+      std::cerr << "got \"" << text << "\", expected \"" << expected << '"'
+		<< std::endl;
+      failures++;
+    }
+}
+
+int
+main (void)
+{
+  Session session;
+  SessionGuard guard (session);
+
+  TypePtr c = Type::get_primitive (PrimitiveType::Char, false);
+  TypePtr i = Type::get_primitive (PrimitiveType::Int, false);
+  TypePtr l = Type::get_primitive (PrimitiveType::Long, false);
+  TypePtr cp = Type::get_pointer (c);
+
+  check_print (i, "int");
+  check_print (cp, "char *");
+  check_print (Type::get_pointer (cp), "char **");
+  check_print (Type::get_function (i, {}, false), "int(*) (void)");
+  check_print (Type::get_function (i, {l}, false), "int(*) (long)");
+  check_print (Type::get_function (i, {l, cp, i}, false),
+	       "int(*) (long, char *, int)");
+  check_print (Type::get_function (cp, {Type::get_function (i, {c, l},
+							    false)},
+				   false),
+	       "char *(*) (int(*) (char, long))");
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+/* token.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <cstring>
+#include "config.h"
+#include "token.hh"
+
+using namespace socc;
+
+/* Translates the character C following a backslash in a string or
+   character literal. Returns false if C does not start a known escape
+   sequence. */
+
+bool
+socc::decode_escape (char c, char &value)
+{
+  switch (c)
+    {
+    case 'n':
+      value = '\n';
+      return true;
+    case 't':
+      value = '\t';
+      return true;
+    case 'r':
+      value = '\r';
+      return true;
+    case 'a':
+      value = '\a';
+      return true;
+    case 'b':
+      value = '\b';
+      return true;
+    case 'f':
+      value = '\f';
+      return true;
+    case 'v':
+      value = '\v';
+      return true;
+    case '\\':
+    case '\'':
+    case '"':
+    case '?':
+      value = c;
+      return true;
+    default:
+      return false;
+    }
+}
+
+uint32_t
+TokenStream::add_string (std::string_view raw)
+{
+  strings.push_back ({raw, std::string_view (), false});
+  return strings.size () - 1;
+}
+
+/* Returns the contents of a string literal with its escapes decoded.
+   Backslash-free runs are copied whole, and an unknown escape stands
+   for the character after the backslash. */
+
+std::string_view
+TokenStream::string (uint32_t index) const
+{
+  StringValue &str = strings[index];
+  if (str.is_decoded)
+    return str.decoded;
+
+  const char *p = str.raw.data ();
+  const char *end = p + str.raw.size ();
+  const char *bslash = (const char *) memchr (p, '\\', end - p);
+  if (bslash == nullptr)
+    str.decoded = str.raw;
+  else
+    {
+      char *buffer = (char *) arena.allocate (str.raw.size (), 1);
+      char *out = buffer;
+      while (bslash != nullptr)
+	{
+	  memcpy (out, p, bslash - p);
+	  out += bslash - p;
+	  p = bslash + 1;
+	  if (p == end)
+	    break;
+	  if (!decode_escape (*p, *out))
+	    *out = *p;
+	  out++;
+	  p++;
+	  bslash = (const char *) memchr (p, '\\', end - p);
+	}
+      if (bslash == nullptr)
+	{
+	  memcpy (out, p, end - p);
+	  out += end - p;
+	}
+      str.decoded = std::string_view (buffer, out - buffer);
+    }
+  str.is_decoded = true;
+  return str.decoded;
+}
+
+/* Decodes every string literal now, so that string can then be called
+   from several threads at once */
+
+void
+TokenStream::decode_strings (void) const
+{
+  for (uint32_t i = 0; i < strings.size (); i++)
+    string (i);
+}
+
+void
+TokenStream::push (const Token &token, uint32_t length)
+{
+  kinds.push_back (token.type);
+  offsets.push_back (token.loc.offset);
+  lengths.push_back (length);
+  switch (token.type)
+    {
+    case TokenType::Identifier:
+      values.push_back (token.sym.value ());
+      break;
+    case TokenType::Integer:
+    case TokenType::Character:
+      values.push_back (integers.size ());
+      integers.push_back ({token.num, token.num_width, token.num_unsigned});
+      break;
+    case TokenType::String:
+      values.push_back (token.str);
+      break;
+    default:
+      values.push_back (0);
+    }
+}
+
+Token
+TokenStream::get (size_t i) const
+{
+  Location loc (file, offsets[i]);
+  TokenType type = kinds[i];
+  switch (type)
+    {
+    case TokenType::Identifier:
+      return Token (type, loc, Symbol (values[i]));
+    case TokenType::Integer:
+    case TokenType::Character:
+      {
+	const IntegerValue &value = integers[values[i]];
+	return Token (type, loc, value.num, value.width, value.is_unsigned);
+      }
+    case TokenType::String:
+      {
+	Token token (type, loc);
+	token.str = values[i];
+	return token;
+      }
+    default:
+      return Token (type, loc);
+    }
+}
+
+/* Number of bits in the target type of an integer of width WIDTH */
+
+unsigned int
+socc::int_width_bits (IntLiteralWidth width)
+{
+  switch (width)
+    {
+    case IntLiteralWidth::Int:
+      return 32;
+    case IntLiteralWidth::Long:
+      return LP_WIDTH * 8;
+    default:
+      return 64;
+    }
+}
+
+static const char *const token_type_names[] = {
+  "Eof",
+  "Character",
+  "String",
+  "Integer",
+  "Identifier",
+  "LeftParen",
+  "RightParen",
+  "LeftBracket",
+  "RightBracket",
+  "LeftBrace",
+  "RightBrace",
+  "Semicolon",
+  "Comma",
+  "Assign",
+  "AssignPlus",
+  "AssignMinus",
+  "AssignMul",
+  "AssignDiv",
+  "AssignMod",
+  "AssignShl",
+  "AssignShr",
+  "AssignAnd",
+  "AssignXor",
+  "AssignOr",
+  "LogicalAnd",
+  "LogicalOr",
+  "LogicalNot",
+  "And",
+  "Xor",
+  "Or",
+  "Not",
+  "Eq",
+  "Ne",
+  "Lt",
+  "Le",
+  "Gt",
+  "Ge",
+  "Shl",
+  "Shr",
+  "Plus",
+  "Minus",
+  "Mul",
+  "Div",
+  "Mod",
+  "Inc",
+  "Dec",
+  "Dot",
+  "Arrow",
+  "KeywordAuto",
+  "KeywordBreak",
+  "KeywordCase",
+  "KeywordChar",
+  "KeywordConst",
+  "KeywordContinue",
+  "KeywordDefault",
+  "KeywordDo",
+  "KeywordDouble",
+  "KeywordElse",
+  "KeywordEnum",
+  "KeywordExtern",
+  "KeywordFloat",
+  "KeywordFor",
+  "KeywordGoto",
+  "KeywordIf",
+  "KeywordInline",
+  "KeywordInt",
+  "KeywordLong",
+  "KeywordRegister",
+  "KeywordRestrict",
+  "KeywordReturn",
+  "KeywordShort",
+  "KeywordSigned",
+  "KeywordSizeof",
+  "KeywordStatic",
+  "KeywordStruct",
+  "KeywordSwitch",
+  "KeywordTypedef",
+  "KeywordUnion",
+  "KeywordUnsigned",
+  "KeywordVoid",
+  "KeywordVolatile",
+  "KeywordWhile"
+};
+
+static_assert (sizeof (token_type_names) / sizeof (*token_type_names)
+	       == (size_t) TokenType::KeywordWhile + 1,
+	       "token_type_names does not match TokenType");
+
+const char *
+socc::token_type_name (TokenType type)
+{
+  return token_type_names[(size_t) type];
+}
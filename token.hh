@@ -17,13 +17,17 @@
 #ifndef _TOKEN_HH
 #define _TOKEN_HH
 
-#include <memory>
+#include <string_view>
+#include <vector>
+#include "arena.hh"
 #include "location.hh"
+#include "symbol.hh"
 
 namespace socc
 {
-  enum class TokenType
+  enum class TokenType : unsigned char
   {
+    Eof,
     Character,
     String,
     Integer,
@@ -111,31 +115,99 @@ namespace socc
     KeywordWhile
   };
 
-  enum class IntLiteralWidth
+  enum class IntLiteralWidth : unsigned char
   {
     Int,
     Long,
     LongLong
   };
 
+  /* Tokens are small values that are copied freely. String literals are
+     kept by the token stream that holds them and referred to by
+     index. */
   class Token
   {
   public:
     TokenType type;
     Location loc;
-    std::string str;
+    Symbol sym; /* For identifiers */
+    uint32_t str; /* For string literals */
     unsigned long long num;
     IntLiteralWidth num_width;
+    bool num_unsigned;
 
+    Token (void) : type (TokenType::Eof) {}
     Token (TokenType type, Location loc) : type (type), loc (loc) {}
-    Token (TokenType type, Location loc, std::string str) :
-      type (type), loc (loc), str (str) {}
+    Token (TokenType type, Location loc, Symbol sym) :
+      type (type), loc (loc), sym (sym) {}
     Token (TokenType type, Location loc, unsigned long long num,
-	   IntLiteralWidth num_width) :
-      type (type), loc (loc), num (num), num_width (num_width) {}
+	   IntLiteralWidth num_width, bool num_unsigned = false) :
+      type (type), loc (loc), num (num), num_width (num_width),
+      num_unsigned (num_unsigned) {}
   };
 
-  typedef std::unique_ptr <Token> TokenPtr;
+  /* Every token lexed from one file, stored as parallel arrays so the
+     parser can walk, peek and back up over them cheaply. values holds
+     the symbol ID of an identifier, or an index into integers or strings
+     for a literal.
+
+     A string literal is kept as the span of source between its quotes.
+     Its escapes are decoded the first time its contents are asked for:
+     a literal without backslashes is returned as that span, and any
+     other is decoded once into the stream's arena. */
+  class TokenStream
+  {
+    struct IntegerValue
+    {
+      unsigned long long num;
+      IntLiteralWidth width;
+      bool is_unsigned;
+    };
+
+    struct StringValue
+    {
+      std::string_view raw;
+      std::string_view decoded;
+      bool is_decoded;
+    };
+
+    uint32_t file;
+    std::vector <TokenType> kinds;
+    std::vector <uint32_t> offsets;
+    std::vector <uint32_t> lengths;
+    std::vector <uint32_t> values;
+    std::vector <IntegerValue> integers;
+    mutable std::vector <StringValue> strings;
+    mutable Arena arena;
+
+  public:
+    explicit TokenStream (uint32_t file) : file (file) {}
+
+    size_t size (void) const { return kinds.size (); }
+    bool empty (void) const { return kinds.empty (); }
+    bool complete (void) const
+    {
+      return !kinds.empty () && kinds.back () == TokenType::Eof;
+    }
+    TokenType kind (size_t i) const { return kinds[i]; }
+    Location location (size_t i) const { return Location (file, offsets[i]); }
+    uint32_t length (size_t i) const { return lengths[i]; }
+    std::string_view raw_string (uint32_t index) const
+    {
+      return strings[index].raw;
+    }
+    std::string_view string (uint32_t index) const;
+    void decode_strings (void) const;
+
+    uint32_t add_string (std::string_view raw);
+    void push (const Token &token, uint32_t length);
+    Token get (size_t i) const;
+  };
+
+  const char *token_type_name (TokenType type);
+  bool decode_escape (char c, char &value);
+  bool lookup_keyword (const char *str, size_t len, TokenType &type);
+  unsigned int int_width_bits (IntLiteralWidth width);
 }
 
 #endif
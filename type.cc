@@ -14,27 +14,160 @@
    You should have received a copy of the GNU General Public License
    along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
 
-#include <unordered_map>
+#include <algorithm>
 #include "config.h"
 #include "context.hh"
-#include "type.hh"
+#include "session.hh"
 
 using namespace socc;
 
-static std::unordered_map <PrimitiveType, std::string> primitive_names = {
-  {PrimitiveType::Char, "char"},
-  {PrimitiveType::Short, "short"},
-  {PrimitiveType::Int, "int"},
-  {PrimitiveType::Long, "long"},
-  {PrimitiveType::LongLong, "long long"},
-  {PrimitiveType::Float, "float"},
-  {PrimitiveType::Double, "double"},
-  {PrimitiveType::LongDouble, "long double"},
-  {PrimitiveType::Void, "void"}
+static const char *const primitive_names[] = {
+  "",
+  "char",
+  "short",
+  "int",
+  "long",
+  "long long",
+  "float",
+  "double",
+  "long double",
+  "void"
 };
 
-std::map <std::string, std::vector <TypePtr>> socc::struct_types;
-std::map <std::string, TypePtr> socc::typedefs;
+static inline size_t
+hash_combine (size_t h, size_t value)
+{
+  return (h ^ value) * 0x9e3779b97f4a7c15ULL;
+}
+
+size_t
+TypeTable::Hash::operator() (TypePtr type) const
+{
+  size_t h = (size_t) type->type;
+  h = hash_combine (h, (size_t) type->storage << 3 | type->is_const << 2
+		    | type->is_volatile << 1 | type->is_unsigned);
+  h = hash_combine (h, (size_t) type->primitive);
+  h = hash_combine (h, (uintptr_t) type->pointer);
+  h = hash_combine (h, type->len);
+  for (TypePtr param : type->params)
+    h = hash_combine (h, (uintptr_t) param);
+  h = hash_combine (h, type->empty_params);
+  h = hash_combine (h, type->struct_name.value ());
+  return h ^ (h >> 32);
+}
+
+bool
+TypeTable::Equal::operator() (TypePtr a, TypePtr b) const
+{
+  return a->type == b->type && a->storage == b->storage
+    && a->is_const == b->is_const && a->is_volatile == b->is_volatile
+    && a->is_unsigned == b->is_unsigned && a->primitive == b->primitive
+    && a->pointer == b->pointer && a->len == b->len
+    && a->params == b->params && a->empty_params == b->empty_params
+    && a->struct_name == b->struct_name;
+}
+
+TypePtr
+TypeTable::insert (const Type &proto)
+{
+  auto it = types.find (&proto);
+  if (it != types.end ())
+    return *it;
+
+  /* Find the unqualified variant first, so every type can hand it out
+     without a lookup */
+  TypePtr unqual = nullptr;
+  if (proto.storage != StorageClass::Unspecified || proto.is_const
+      || proto.is_volatile)
+    {
+      Type bare (proto);
+      bare.storage = StorageClass::Unspecified;
+      bare.is_const = false;
+      bare.is_volatile = false;
+      unqual = insert (bare);
+    }
+  Type *type = arena.create <Type> (proto);
+  type->unqual = unqual ? unqual : type;
+  type->table = this;
+  types.insert (type);
+  return type;
+}
+
+const TypeLayout *
+TypeTable::save_layout (TypeLayout layout)
+{
+  std::lock_guard <std::mutex> guard (lock);
+  return arena.create <TypeLayout> (std::move (layout));
+}
+
+TypePtr
+Type::intern (const Type &proto)
+{
+  return Session::current ().types.intern (proto);
+}
+
+TypePtr
+Type::get_primitive (PrimitiveType type, bool is_unsigned)
+{
+  return intern (Type (type, is_unsigned));
+}
+
+TypePtr
+Type::get_pointer (TypePtr type)
+{
+  return intern (Type (type));
+}
+
+TypePtr
+Type::get_array (TypePtr type, unsigned long len)
+{
+  return intern (Type (type, len));
+}
+
+TypePtr
+Type::get_function (TypePtr rettype, std::vector <TypePtr> params,
+		    bool empty_params)
+{
+  Type proto (rettype, std::move (params));
+  proto.empty_params = empty_params;
+  return intern (proto);
+}
+
+TypePtr
+Type::get_struct (std::vector <TypePtr> members)
+{
+  return intern (Type (std::move (members)));
+}
+
+/* Structs with the same tag declared in different scopes are different
+   types, told apart by their members */
+
+TypePtr
+Type::get_struct (Symbol name, std::vector <TypePtr> members)
+{
+  return intern (Type (name, std::move (members)));
+}
+
+TypePtr
+Type::qualified (bool is_const, bool is_volatile) const
+{
+  if (is_const == this->is_const && is_volatile == this->is_volatile)
+    return this;
+  Type proto (*this);
+  proto.is_const = is_const;
+  proto.is_volatile = is_volatile;
+  return table->intern (proto);
+}
+
+TypePtr
+Type::with_storage (StorageClass storage) const
+{
+  if (storage == this->storage)
+    return this;
+  Type proto (*this);
+  proto.storage = storage;
+  return table->intern (proto);
+}
 
 TypePtr
 Context::parse_type (Location loc, TypeContext ctx)
@@ -52,16 +185,16 @@ Context::parse_type (Location loc, TypeContext ctx)
 
   while (!finish)
     {
-      TokenPtr token = next_token ();
-      if (token == nullptr)
+      const Token &token = peek_token ();
+      if (token.type == TokenType::Eof)
 	return nullptr;
-      switch (token->type)
+      switch (token.type)
 	{
 	case TokenType::KeywordUnsigned:
 	  if (primitive == -1)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else if (sign)
-	    error (token->loc, "multiple sign modifiers specified");
+	    error (token.loc, "multiple sign modifiers specified");
 	  else
 	    {
 	      sign = 1;
@@ -70,9 +203,9 @@ Context::parse_type (Location loc, TypeContext ctx)
 	  break;
 	case TokenType::KeywordSigned:
 	  if (primitive == -1)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else if (sign)
-	    error (token->loc, "multiple sign modifiers specified");
+	    error (token.loc, "multiple sign modifiers specified");
 	  else
 	    {
 	      sign = -1;
@@ -87,9 +220,9 @@ Context::parse_type (Location loc, TypeContext ctx)
 	  break;
 	case TokenType::KeywordChar:
 	  if (primitive == -1)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else if (primtype != PrimitiveType::Unspecified)
-	    error (token->loc, "multiple base types specified");
+	    error (token.loc, "multiple base types specified");
 	  else
 	    {
 	      primtype = PrimitiveType::Char;
@@ -98,10 +231,10 @@ Context::parse_type (Location loc, TypeContext ctx)
 	  break;
 	case TokenType::KeywordShort:
 	  if (primitive == -1)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else if (primtype != PrimitiveType::Unspecified
 		   && primtype != PrimitiveType::Int)
-	    error (token->loc, "multiple base types specified");
+	    error (token.loc, "multiple base types specified");
 	  else
 	    {
 	      primtype = PrimitiveType::Short;
@@ -110,12 +243,12 @@ Context::parse_type (Location loc, TypeContext ctx)
 	  break;
 	case TokenType::KeywordInt:
 	  if (primitive == -1)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else if ((primtype != PrimitiveType::Unspecified
 		    && primtype != PrimitiveType::Short
 		    && primtype != PrimitiveType::Long
 		    && primtype != PrimitiveType::LongLong) || seen_int)
-	    error (token->loc, "multiple base types specified");
+	    error (token.loc, "multiple base types specified");
 	  if (primtype == PrimitiveType::Unspecified)
 	    {
 	      primtype = PrimitiveType::Int;
@@ -125,7 +258,7 @@ Context::parse_type (Location loc, TypeContext ctx)
 	  break;
 	case TokenType::KeywordLong:
 	  if (primitive == -1)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else if (primtype == PrimitiveType::Long)
 	    {
 	      primtype = PrimitiveType::LongLong;
@@ -138,77 +271,101 @@ Context::parse_type (Location loc, TypeContext ctx)
 	      primitive = 1;
 	    }
 	  else
-	    error (token->loc, "multiple base types specified");
+	    error (token.loc, "multiple base types specified");
 	  break;
 	case TokenType::KeywordVoid:
 	  if (type || primitive != 0 || primtype != PrimitiveType::Unspecified)
-	    error (token->loc, "expected type modifier or identifier");
+	    error (token.loc, "expected type modifier or identifier");
 	  else
 	    {
 	      primitive = -1;
 	      if (sign != 0)
-		error (token->loc, bold ("void") + "specifier with " +
+		error (token.loc, bold ("void") + "specifier with " +
 		       bold (sign == 1 ? "unsigned" : "signed"));
-	      type = std::make_shared <Type> (PrimitiveType::Void, false);
-	      type->is_const = is_const;
-	      type->is_volatile = is_volatile;
+	      type = Type::get_primitive (PrimitiveType::Void, false)
+		->qualified (is_const, is_volatile);
 	      is_const = false;
 	      is_volatile = false;
 	    }
 	  break;
 	case TokenType::KeywordAuto:
 	  if (ctx != TypeContext::Local)
-	    error (token->loc, "storage class " + bold ("auto") +
+	    error (token.loc, "storage class " + bold ("auto") +
 		   " is invalid in this context");
 	  else if (storage != StorageClass::Unspecified)
-	    error (token->loc, "multiple storage classes specified");
+	    error (token.loc, "multiple storage classes specified");
 	  else
 	    storage = StorageClass::Auto;
 	  break;
 	case TokenType::KeywordStatic:
 	  if (ctx == TypeContext::FuncParam || ctx == TypeContext::Cast)
-	    error (token->loc, "storage class " + bold ("static") +
+	    error (token.loc, "storage class " + bold ("static") +
 		   " is invalid in this context");
 	  else if (storage != StorageClass::Unspecified)
-	    error (token->loc, "multiple storage classes specified");
+	    error (token.loc, "multiple storage classes specified");
 	  else
 	    storage = StorageClass::Static;
 	  break;
 	case TokenType::KeywordExtern:
 	  if (ctx == TypeContext::FuncParam || ctx == TypeContext::Cast)
-	    error (token->loc, "storage class " + bold ("static") +
+	    error (token.loc, "storage class " + bold ("static") +
 		   " is invalid in this context");
 	  else if (storage != StorageClass::Unspecified)
-	    error (token->loc, "multiple storage classes specified");
+	    error (token.loc, "multiple storage classes specified");
 	  else
 	    storage = StorageClass::Extern;
 	  break;
 	case TokenType::KeywordRegister:
 	  if (ctx != TypeContext::Local)
-	    error (token->loc, "storage class " + bold ("register") +
+	    error (token.loc, "storage class " + bold ("register") +
 			" is invalid in this context");
 	  else if (storage != StorageClass::Unspecified)
-	    error (token->loc, "multiple storage classes specified");
+	    error (token.loc, "multiple storage classes specified");
 	  else
 	    storage = StorageClass::Register;
 	  break;
+	case TokenType::Identifier:
+	  {
+	    /* A typedef name is a type specifier unless an ordinary
+	       identifier declared in an inner scope hides it. Nothing
+	       declares typedef names yet, so no input reaches this. */
+	    const Binding *def = typedef_names.find (token.sym);
+	    const Binding *var = ordinary.find (token.sym);
+	    if (type || primitive != 0 || !def
+		|| (var && var->depth > def->depth))
+	      finish = true;
+	    else
+	      {
+		type = def->type;
+		primitive = -1;
+	      }
+	  }
+	  break;
 	case TokenType::Mul:
+	  if (primitive == 0)
+	    {
+	      /* Not a declaration, but an expression starting with a
+		 dereference */
+	      finish = true;
+	      break;
+	    }
 	  if (primitive == 1)
-	    type = std::make_shared <Type> (primtype, sign == 1);
+	    type = Type::get_primitive (primtype, sign == 1);
 	  primitive = -1;
-	  type->is_const = is_const;
-	  type->is_volatile = is_volatile;
+	  type = Type::get_pointer (type->qualified
+				    (type->is_const || is_const,
+				     type->is_volatile || is_volatile));
 	  is_const = false;
 	  is_volatile = false;
-	  type = std::make_shared <Type> (std::move (type));
 	  break;
 	default:
-	  token_stack.push (std::move (token));
 	  finish = true;
 	}
+      if (!finish)
+	consume_token ();
     }
   if (primitive == 1)
-    type = std::make_shared <Type> (primtype, sign == 1);
+    type = Type::get_primitive (primtype, sign == 1);
   else if (!type)
     return nullptr;
   if (type->type == TypeType::Primitive
@@ -219,14 +376,13 @@ Context::parse_type (Location loc, TypeContext ctx)
 	     " type is invalid in this context");
       return nullptr;
     }
-  type->is_const = is_const;
-  type->is_volatile = is_volatile;
-  type->storage = storage;
-  return type;
+  return type->qualified (type->is_const || is_const,
+			 type->is_volatile || is_volatile)
+    ->with_storage (storage);
 }
 
 size_t
-Type::primitive_width (void)
+Type::primitive_width (void) const
 {
   switch (primitive)
     {
@@ -251,115 +407,140 @@ Type::primitive_width (void)
     }
 }
 
-size_t
-Type::struct_width (void)
+/* Alignment of scalars is their size, capped at the strictest alignment
+   the target's ABI demands: 16 bytes on LP64 targets and 4 on ILP32 ones,
+   as on x86-64 and i386 */
+
+static constexpr size_t MAX_SCALAR_ALIGN = LP_WIDTH == 8 ? 16 : 4;
+
+static inline size_t
+align_up (size_t offset, size_t align)
 {
-  size_t width = 0;
-  if (struct_name.empty ())
-    {
-      for (TypePtr &type : params)
-	width += type->width ();
-    }
-  else
+  return (offset + align - 1) & ~(align - 1);
+}
+
+/* Fills in LAYOUT and returns true if the type is complete. Void, named
+   structs whose members are not known, and arrays and structs containing
+   them have no layout. */
+
+bool
+Type::compute_layout (TypeLayout &layout) const
+{
+  switch (type)
     {
-      if (struct_types.count (struct_name))
+    case TypeType::Primitive:
+      layout.size = primitive_width ();
+      if (layout.size == 0)
+	return false;
+      layout.align = std::min (layout.size, MAX_SCALAR_ALIGN);
+      break;
+    case TypeType::Pointer:
+    case TypeType::Function:
+      layout.size = LP_WIDTH;
+      layout.align = LP_WIDTH;
+      break;
+    case TypeType::Array:
+      {
+	const TypeLayout *elem = pointer->layout ();
+	if (!elem)
+	  return false;
+	layout.size = elem->size * len;
+	layout.align = elem->align;
+      }
+      break;
+    case TypeType::Struct:
+      if (params.empty () && !struct_name.empty ())
+	return false;
+      layout.offsets.reserve (params.size ());
+      for (TypePtr member : params)
 	{
-	  for (TypePtr &type : struct_types[struct_name])
-	    width += type->width ();
+	  const TypeLayout *m = member->layout ();
+	  if (!m)
+	    return false;
+	  layout.size = align_up (layout.size, m->align);
+	  layout.offsets.push_back (layout.size);
+	  layout.size += m->size;
+	  layout.align = std::max (layout.align, m->align);
 	}
-      else
-	return 0;
+      layout.size = align_up (layout.size, layout.align);
+      break;
     }
-  return width;
+  return true;
 }
 
-std::string
-Type::primitive_name (void)
+/* Computes the layout of a complete type on first use and returns the
+   cached copy afterwards. Incomplete types are not cached, since nothing
+   about them is known yet. Qualified variants share the layout of their
+   unqualified type. If two threads race to compute a layout, both return
+   the one that was published first. */
+
+const TypeLayout *
+Type::layout (void) const
 {
-  std::string name;
-  if (is_const)
-    name += "const ";
-  if (is_volatile)
-    name += "volatile ";
-  return name + primitive_names[primitive];
+  if (unqual != this)
+    return unqual->layout ();
+  const TypeLayout *cached = cached_layout.ptr.load (std::memory_order_acquire);
+  if (cached)
+    return cached;
+
+  TypeLayout computed;
+  if (!compute_layout (computed))
+    return nullptr;
+  const TypeLayout *saved = table->save_layout (std::move (computed));
+  if (!cached_layout.ptr.compare_exchange_strong (cached, saved,
+						  std::memory_order_acq_rel,
+						  std::memory_order_acquire))
+    return cached;
+  return saved;
 }
 
-std::string
-Type::pointer_name (void)
+/* Size of the type in bytes, or 0 if it is incomplete */
+
+size_t
+Type::width (void) const
 {
-  std::string name = pointer->name ();
-  if (name.back () != '*')
-    name += ' ';
-  name += '*';
-  if (is_const)
-    {
-      name += "const";
-      if (is_volatile)
-	name += ' ';
-    }
-  if (is_volatile)
-    name += "volatile";
-  return name;
+  const TypeLayout *l = layout ();
+  return l ? l->size : 0;
 }
 
-std::string
-Type::function_name (void)
+void
+Type::print_qualifiers (Writer &os) const
 {
-  std::string name = pointer->name () + "(*";
   if (is_const)
     {
-      name += "const";
+      os << "const";
       if (is_volatile)
-	name += ' ';
+	os << ' ';
     }
   if (is_volatile)
-    name += "volatile";
-  name += ") (";
-  if (params.empty ())
-    name += "void";
-  else
-    {
-      name += params[0]->name ();
-      for (size_t i = 1; i < params.size (); i++)
-	name += params[i]->name ();
-    }
-  return name + ')';
+    os << "volatile";
 }
 
-size_t
-Type::width (void)
+/* Whether the spelling written by print ends in an asterisk, so a
+   declarator that follows needs no space before it */
+
+bool
+Type::ends_in_star (void) const
 {
-  switch (type)
-    {
-    case TypeType::Primitive:
-      return primitive_width ();
-    case TypeType::Pointer:
-    case TypeType::Function:
-      return LP_WIDTH;
-    case TypeType::Struct:
-      return struct_width ();
-    default:
-      return 0;
-    }
+  return type == TypeType::Pointer && !is_const && !is_volatile;
 }
 
-std::string
-Type::name (void)
+void
+Type::print (Writer &os) const
 {
-  std::string name;
   switch (storage)
     {
     case StorageClass::Auto:
-      name += "auto ";
+      os << "auto ";
       break;
     case StorageClass::Static:
-      name += "static ";
+      os << "static ";
       break;
     case StorageClass::Extern:
-      name += "extern ";
+      os << "extern ";
       break;
     case StorageClass::Register:
-      name += "register ";
+      os << "register ";
       break;
     default:
       break;
@@ -367,19 +548,53 @@ Type::name (void)
   switch (type)
     {
     case TypeType::Primitive:
-      name += primitive_name ();
+      if (is_const)
+	os << "const ";
+      if (is_volatile)
+	os << "volatile ";
+      os << primitive_names[(int) primitive];
       break;
     case TypeType::Pointer:
-      name += pointer_name ();
+      pointer->print (os);
+      if (!pointer->ends_in_star ())
+	os << ' ';
+      os << '*';
+      print_qualifiers (os);
       break;
     case TypeType::Function:
-      name += function_name ();
+      pointer->print (os);
+      os << "(*";
+      print_qualifiers (os);
+      os << ") (";
+      if (params.empty ())
+	os << "void";
+      for (size_t i = 0; i < params.size (); i++)
+	{
+	  if (i > 0)
+	    os << ", ";
+	  params[i]->print (os);
+	}
+      os << ')';
       break;
     case TypeType::Struct:
-      name += "struct " + (struct_name.empty () ? "<anonymous> " : struct_name);
+      os << "struct ";
+      if (struct_name.empty ())
+	os << "<anonymous> ";
+      else
+	os << struct_name;
       break;
     default:
-      return std::string ();
+      break;
     }
-  return name;
+}
+
+/* Prints a declaration of NAME with this type */
+
+void
+Type::print_declarator (Writer &os, Symbol name) const
+{
+  print (os);
+  if (!ends_in_star ())
+    os << ' ';
+  os << name;
 }
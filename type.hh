@@ -17,10 +17,12 @@
 #ifndef _TYPE_HH
 #define _TYPE_HH
 
+#include <atomic>
+#include <string>
 #include <vector>
-#include <map>
-#include <memory>
 #include "location.hh"
+#include "symbol.hh"
+#include "writer.hh"
 
 namespace socc
 {
@@ -65,51 +67,109 @@ namespace socc
     Cast
   };
 
+  class Arena;
   class Type;
-  typedef std::shared_ptr <Type> TypePtr;
+  struct TypeLayout;
+  class TypeTable;
+  typedef const Type *TypePtr;
 
+  /* Types are hash-consed: every distinct combination of kind, storage
+     class, qualifiers, base type, array length, parameters and struct
+     name exists once, for the life of the session that made it, and is
+     only reachable through a const pointer. Two types of a session are
+     the same exactly when their pointers are equal. New types are made
+     with the static constructors below, and variants of an existing type
+     with qualified and with_storage. */
   class Type
   {
-    size_t primitive_width (void);
-    size_t struct_width (void);
-    std::string primitive_name (void);
-    std::string pointer_name (void);
-    std::string function_name (void);
+    friend class Arena;
+    friend class TypeTable;
 
-  public:
-    TypeType type;
-    StorageClass storage;
-    TypeContext ctx;
-    bool is_const;
-    bool is_volatile;
-    bool is_unsigned;
-    PrimitiveType primitive;
-    TypePtr pointer; /* For pointer, array, and function return types */
-    unsigned long len; /* For array size */
-    std::vector <TypePtr> params; /* For function params and anonymous struct 
-				     members */
-    bool empty_params;
-    std::string struct_name;
+    /* Layout of the type once it has been computed. Types are shared
+       between threads, so it is published atomically; copies of a type
+       start without one. */
+    struct LayoutCache
+    {
+      std::atomic <const TypeLayout *> ptr {nullptr};
+
+      LayoutCache (void) = default;
+      LayoutCache (const LayoutCache &) {}
+    };
+
+    TypePtr unqual = nullptr;
+    mutable LayoutCache cached_layout;
+
+    /* Table of the session that made the type, which also owns its
+       layout and its qualified variants whichever session is current */
+    TypeTable *table = nullptr;
 
     Type (PrimitiveType type, bool is_unsigned) :
       type (TypeType::Primitive), is_unsigned (is_unsigned), primitive (type) {}
     Type (TypePtr type) :
-      type (TypeType::Pointer), pointer (std::move (type)) {}
+      type (TypeType::Pointer), pointer (type) {}
     Type (TypePtr type, unsigned long len) :
-      type (TypeType::Array), pointer (std::move (type)), len (len) {}
+      type (TypeType::Array), pointer (type), len (len) {}
     Type (TypePtr rettype, std::vector <TypePtr> params) :
-      type (TypeType::Function), pointer (std::move (rettype)),
+      type (TypeType::Function), pointer (rettype),
       params (std::move (params)) {}
     Type (std::vector <TypePtr> params) :
       type (TypeType::Struct), params (std::move (params)) {}
-    Type (std::string struct_name) :
-      type (TypeType::Struct), struct_name (struct_name) {}
-    size_t width (void);
-    std::string name (void);
+    Type (Symbol struct_name, std::vector <TypePtr> members) :
+      type (TypeType::Struct), params (std::move (members)),
+      struct_name (struct_name) {}
+    Type (const Type &other) = default;
+
+    static TypePtr intern (const Type &proto);
+    size_t primitive_width (void) const;
+    bool compute_layout (TypeLayout &layout) const;
+    void print_qualifiers (Writer &os) const;
+
+  public:
+    TypeType type;
+    StorageClass storage = StorageClass::Unspecified;
+    bool is_const = false;
+    bool is_volatile = false;
+    bool is_unsigned = false;
+    PrimitiveType primitive = PrimitiveType::Unspecified;
+    TypePtr pointer = nullptr; /* For pointer, array, and function return
+				  types */
+    unsigned long len = 0; /* For array size */
+    std::vector <TypePtr> params; /* For function params and struct
+				     members */
+    bool empty_params = false;
+    Symbol struct_name;
+
+    static TypePtr get_primitive (PrimitiveType type, bool is_unsigned);
+    static TypePtr get_pointer (TypePtr type);
+    static TypePtr get_array (TypePtr type, unsigned long len);
+    static TypePtr get_function (TypePtr rettype,
+				 std::vector <TypePtr> params,
+				 bool empty_params);
+    static TypePtr get_struct (std::vector <TypePtr> members);
+    static TypePtr get_struct (Symbol name,
+			       std::vector <TypePtr> members = {});
+
+    /* The same type without qualifiers or storage class */
+    TypePtr unqualified (void) const { return unqual; }
+    TypePtr qualified (bool is_const, bool is_volatile) const;
+    TypePtr with_storage (StorageClass storage) const;
+    /* Null for incomplete types */
+    const TypeLayout *layout (void) const;
+    size_t width (void) const;
+    bool ends_in_star (void) const;
+    void print (Writer &os) const;
+    void print_declarator (Writer &os, Symbol name) const;
+  };
+
+  /* Size and alignment of a type on the target, in bytes. For structs,
+     OFFSETS holds the offset of each member. */
+  struct TypeLayout
+  {
+    size_t size = 0;
+    size_t align = 1;
+    std::vector <size_t> offsets;
   };
 
-  extern std::map <std::string, std::vector <TypePtr>> struct_types;
-  extern std::map <std::string, TypePtr> typedefs;
 }
 
 #endif
@@ -0,0 +1,106 @@
+/* writer.cc -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <cerrno>
+#include <charconv>
+#include <unistd.h>
+#include "session.hh"
+#include "writer.hh"
+
+using namespace socc;
+
+void
+Writer::write_out (const char *str, size_t n)
+{
+  if (target)
+    {
+      target->append (str, n);
+      return;
+    }
+  while (n > 0 && write_errno == 0)
+    {
+      ssize_t ret = ::write (fd, str, n);
+      if (ret < 0)
+	{
+	  if (errno != EINTR)
+	    write_errno = errno;
+	  continue;
+	}
+      str += ret;
+      n -= ret;
+    }
+}
+
+void
+Writer::flush (void)
+{
+  write_out (buffer.get (), len);
+  len = 0;
+}
+
+/* Writes data that does not fit in the rest of the buffer. Anything at
+   least as large as the buffer bypasses it. */
+
+void
+Writer::write_slow (const char *str, size_t n)
+{
+  flush ();
+  if (n < BUFFER_SIZE)
+    {
+      memcpy (buffer.get (), str, n);
+      len = n;
+    }
+  else
+    write_out (str, n);
+}
+
+Writer &
+Writer::spaces (size_t n)
+{
+  static const char blank[] = "                                ";
+  while (n > sizeof (blank) - 1)
+    {
+      write (blank, sizeof (blank) - 1);
+      n -= sizeof (blank) - 1;
+    }
+  return write (blank, n);
+}
+
+/* Base 2 needs up to 64 digits */
+
+Writer &
+Writer::number (unsigned long long value, int base)
+{
+  char buf[64];
+  std::to_chars_result res = std::to_chars (buf, buf + sizeof (buf), value,
+					    base);
+  return write (buf, res.ptr - buf);
+}
+
+Writer &
+Writer::number (long long value)
+{
+  char buf[24];
+  std::to_chars_result res = std::to_chars (buf, buf + sizeof (buf), value);
+  return write (buf, res.ptr - buf);
+}
+
+Writer &
+Writer::operator<< (const Location &loc)
+{
+  PresumedLocation pl = Session::current ().sources.presumed (loc);
+  return *this << pl.name << ':' << pl.line << '.' << pl.col;
+}
@@ -0,0 +1,115 @@
+/* writer.hh -- This file is part of SOCC.
+   Copyright (C) 2021 XNSC
+
+   SOCC is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SOCC is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SOCC. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _WRITER_HH
+#define _WRITER_HH
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "location.hh"
+#include "symbol.hh"
+
+namespace socc
+{
+  /* Buffered output to a file descriptor or a string. Text is only
+     copied into a large buffer, which is written out when it fills up, on
+     flush and when the writer is destroyed. Numbers are formatted in place
+     without going through a locale. The first write error is kept, and
+     nothing more is written after it. */
+  class Writer
+  {
+    static constexpr size_t BUFFER_SIZE = 65536;
+
+    int fd;
+    std::string *target;
+    std::unique_ptr <char[]> buffer;
+    size_t len;
+    int write_errno;
+
+    void write_out (const char *str, size_t n);
+    void write_slow (const char *str, size_t n);
+
+  public:
+    explicit Writer (int fd) :
+      fd (fd), target (nullptr), buffer (new char[BUFFER_SIZE]), len (0),
+      write_errno (0) {}
+    explicit Writer (std::string &target) :
+      fd (-1), target (&target), buffer (new char[BUFFER_SIZE]), len (0),
+      write_errno (0) {}
+    Writer (const Writer &) = delete;
+    ~Writer (void) { flush (); }
+    Writer &operator= (const Writer &) = delete;
+
+    void flush (void);
+
+    /* The errno of the first failed write, or 0 */
+    int error (void) const { return write_errno; }
+
+    Writer &
+    write (const char *str, size_t n)
+    {
+      if (n > BUFFER_SIZE - len)
+	write_slow (str, n);
+      else
+	{
+	  memcpy (buffer.get () + len, str, n);
+	  len += n;
+	}
+      return *this;
+    }
+
+    Writer &
+    put (char c)
+    {
+      if (len == BUFFER_SIZE)
+	flush ();
+      buffer[len++] = c;
+      return *this;
+    }
+
+    Writer &spaces (size_t n);
+    Writer &number (unsigned long long value, int base = 10);
+    Writer &number (long long value);
+
+    Writer &operator<< (char c) { return put (c); }
+    Writer &
+    operator<< (std::string_view str)
+    {
+      return write (str.data (), str.size ());
+    }
+    Writer &operator<< (const char *str) { return write (str, strlen (str)); }
+    Writer &operator<< (int value) { return number ((long long) value); }
+    Writer &operator<< (long value) { return number ((long long) value); }
+    Writer &operator<< (long long value) { return number (value); }
+    Writer &
+    operator<< (unsigned int value)
+    {
+      return number ((unsigned long long) value);
+    }
+    Writer &
+    operator<< (unsigned long value)
+    {
+      return number ((unsigned long long) value);
+    }
+    Writer &operator<< (unsigned long long value) { return number (value); }
+    Writer &operator<< (Symbol sym) { return *this << sym.str (); }
+    Writer &operator<< (const Location &loc);
+  };
+}
+
+#endif